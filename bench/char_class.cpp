@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <klib/unicode.h>
+
+#include "char_class.h"
+
+namespace {
+
+// Every line of the TXT files of the corpus
+const std::vector<std::string> &corpus() {
+  static const auto result = [] {
+    std::vector<std::string> lines;
+    for (const auto &entry :
+         std::filesystem::recursive_directory_iterator("corpus")) {
+      if (entry.path().extension() == ".txt") {
+        std::ifstream ifs(entry.path());
+        std::string line;
+        while (std::getline(ifs, line)) {
+          lines.push_back(line);
+        }
+      }
+    }
+    return lines;
+  }();
+
+  return result;
+}
+
+std::int64_t corpus_bytes() {
+  std::int64_t result = 0;
+  for (const auto &line : corpus()) {
+    result += static_cast<std::int64_t>(std::size(line));
+  }
+  return result;
+}
+
+// What str_size() did before count_cjk()
+void utf8_to_utf32(benchmark::State &state) {
+  for ([[maybe_unused]] auto _ : state) {
+    for (const auto &line : corpus()) {
+      const auto utf32 = klib::utf8_to_utf32(line);
+      benchmark::DoNotOptimize(
+          std::count_if(std::begin(utf32), std::end(utf32),
+                        [](char32_t c) { return klib::is_cjk(c); }));
+    }
+  }
+
+  state.SetBytesProcessed(state.iterations() * corpus_bytes());
+}
+
+void count_cjk(benchmark::State &state) {
+  for ([[maybe_unused]] auto _ : state) {
+    for (const auto &line : corpus()) {
+      benchmark::DoNotOptimize(kepub::count_cjk(line));
+    }
+  }
+
+  state.SetBytesProcessed(state.iterations() * corpus_bytes());
+}
+
+void classify(benchmark::State &state) {
+  for ([[maybe_unused]] auto _ : state) {
+    for (const auto &line : corpus()) {
+      benchmark::DoNotOptimize(kepub::classify(line));
+    }
+  }
+
+  state.SetBytesProcessed(state.iterations() * corpus_bytes());
+}
+
+}  // namespace
+
+BENCHMARK(utf8_to_utf32);
+BENCHMARK(count_cjk);
+BENCHMARK(classify);
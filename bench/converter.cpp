@@ -0,0 +1,51 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "converter.h"
+
+namespace {
+
+// Every line of the TXT files of the corpus
+const std::vector<std::string> &corpus() {
+  static const auto result = [] {
+    std::vector<std::string> lines;
+    for (const auto &entry :
+         std::filesystem::recursive_directory_iterator("corpus")) {
+      if (entry.path().extension() == ".txt") {
+        std::ifstream ifs(entry.path());
+        std::string line;
+        while (std::getline(ifs, line)) {
+          lines.push_back(line);
+        }
+      }
+    }
+    return lines;
+  }();
+
+  return result;
+}
+
+// One converter shared by all threads, like trans_str()
+void convert(benchmark::State &state) {
+  static const kepub::Converter converter;
+  const auto &lines = corpus();
+
+  std::int64_t bytes = 0;
+  for ([[maybe_unused]] auto _ : state) {
+    for (const auto &line : lines) {
+      benchmark::DoNotOptimize(converter.convert(line));
+      bytes += static_cast<std::int64_t>(std::size(line));
+    }
+  }
+
+  state.SetBytesProcessed(bytes);
+}
+
+}  // namespace
+
+BENCHMARK(convert)->ThreadRange(1, 8)->UseRealTime();
@@ -0,0 +1,85 @@
+#include <filesystem>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <klib/unicode.h>
+#include <klib/util.h>
+#include <parallel_hashmap/phmap.h>
+
+#include "fold_table.h"
+
+namespace {
+
+// Every TXT file of the corpus
+const std::u32string &corpus() {
+  static const auto result = [] {
+    std::u32string str;
+    for (const auto &entry :
+         std::filesystem::recursive_directory_iterator("corpus")) {
+      if (entry.path().extension() == ".txt") {
+        str.append(
+            klib::utf8_to_utf32(klib::read_file(entry.path().string(), false)));
+      }
+    }
+    return str;
+  }();
+
+  return result;
+}
+
+// The lookups custom_trans() did before the fold table
+char32_t map_fold(char32_t code_point, bool translation) {
+  using Map = phmap::flat_hash_map<char32_t, char32_t>;
+  static const auto maps = [] {
+    std::pair<Map, Map> result;
+    for (const auto &entry : kepub::fold_entries) {
+      (entry.translation_only_ ? result.first : result.second)
+          .emplace(entry.from_, entry.to_);
+    }
+    return result;
+  }();
+
+  if (translation) {
+    if (auto iter = maps.first.find(code_point);
+        iter != std::end(maps.first)) {
+      code_point = iter->second;
+    }
+  }
+
+  if (auto iter = maps.second.find(code_point);
+      iter != std::end(maps.second)) {
+    code_point = iter->second;
+  }
+
+  return code_point;
+}
+
+template <typename Fold>
+void run(benchmark::State &state, Fold fold) {
+  const auto &text = corpus();
+  const auto translation = state.range(0) != 0;
+
+  for ([[maybe_unused]] auto _ : state) {
+    char32_t sum = 0;
+    for (auto code_point : text) {
+      sum += fold(code_point, translation);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<std::int64_t>(std::size(text)));
+}
+
+void fold_phmap(benchmark::State &state) { run(state, map_fold); }
+
+void fold_table(benchmark::State &state) {
+  run(state, [](char32_t code_point, bool translation) {
+    return kepub::fold_table.fold(code_point, translation);
+  });
+}
+
+}  // namespace
+
+BENCHMARK(fold_phmap)->Arg(0)->Arg(1);
+BENCHMARK(fold_table)->Arg(0)->Arg(1);
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <klib/unicode.h>
+#include <klib/util.h>
+#include <boost/algorithm/string.hpp>
+
+#include "replacer.h"
+
+namespace {
+
+// The first 1MB of the TXT files of the corpus
+const std::string &corpus() {
+  static const auto result = [] {
+    std::string str;
+    for (const auto &entry :
+         std::filesystem::recursive_directory_iterator("corpus")) {
+      if (entry.path().extension() == ".txt") {
+        str.append(klib::read_file(entry.path().string(), false));
+      }
+    }
+
+    // Cut at a code point boundary
+    auto size = std::min<std::size_t>(std::size(str), 1024 * 1024);
+    while (size < std::size(str) &&
+           (static_cast<std::uint8_t>(str[size]) & 0xC0) == 0x80) {
+      ++size;
+    }
+    str.resize(size);
+
+    return str;
+  }();
+
+  return result;
+}
+
+// Two code point phrases taken from the corpus, so that some of them match
+std::vector<std::pair<std::string, std::string>> replacements(
+    std::size_t count) {
+  const auto text = klib::utf8_to_utf32(corpus());
+
+  std::vector<std::pair<std::string, std::string>> result;
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto offset = (i * 7919) % (std::size(text) - 1);
+    result.emplace_back(klib::utf32_to_utf8(text.substr(offset, 2)),
+                        std::to_string(i));
+  }
+
+  return result;
+}
+
+void replace_all(benchmark::State &state) {
+  const auto pairs = replacements(static_cast<std::size_t>(state.range(0)));
+
+  for ([[maybe_unused]] auto _ : state) {
+    auto str = corpus();
+    for (const auto &[from, to] : pairs) {
+      boost::replace_all(str, from, to);
+    }
+    benchmark::DoNotOptimize(str);
+  }
+
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<std::int64_t>(std::size(corpus())));
+}
+
+void replacer(benchmark::State &state) {
+  const kepub::Replacer replacer(
+      replacements(static_cast<std::size_t>(state.range(0))));
+
+  for ([[maybe_unused]] auto _ : state) {
+    auto str = corpus();
+    replacer.replace(str);
+    benchmark::DoNotOptimize(str);
+  }
+
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<std::int64_t>(std::size(corpus())));
+}
+
+}  // namespace
+
+BENCHMARK(replace_all)->Arg(5)->Arg(100)->Arg(1000);
+BENCHMARK(replacer)->Arg(5)->Arg(100)->Arg(1000)->Arg(5000);
@@ -1,4 +1,5 @@
 option(KEPUB_BUILD_TEST "Build test" OFF)
+option(KEPUB_BUILD_BENCH "Build benchmark" OFF)
 
 option(KEPUB_FORMAT "Format code using clang-format and cmake-format" OFF)
 option(KEPUB_SANITIZER "Build with AddressSanitizer and UndefinedSanitizer" OFF)
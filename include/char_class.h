@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "kepub_export.h"
+
+namespace kepub {
+
+enum class CharClass : std::uint8_t {
+  // Anything not below, reported by str_check()
+  Unknown = 0,
+  // klib::is_cjk()
+  Cjk = 1,
+  // klib::is_chinese_punctuation() and '◇'
+  Punctuation = 2,
+  // ASCII letters, digits and space, skipped by str_check()
+  Ignored = 3
+};
+
+// The class and the flags of every code point, in pages of 256 code points.
+// Identical pages are shared, so the table is a few KB
+class KEPUB_EXPORT CharTable {
+ public:
+  // The properties of the first or the last code point of a line that decide
+  // how push_back() joins it
+  enum Flag : std::uint8_t {
+    // klib::is_cjk()
+    Cjk = 1 << 0,
+    // klib::is_chinese_punctuation()
+    Punctuation = 1 << 1,
+    AsciiAlpha = 1 << 2,
+    AsciiAlnum = 1 << 3,
+    // Joins a line ending with '，'
+    Opening = 1 << 4,
+    // Joins a line not ending with punctuation
+    Closing = 1 << 5,
+    Comma = 1 << 6,
+    // Closing, but not worth a warning
+    Exclamation = 1 << 7
+  };
+
+  [[nodiscard]] static const CharTable &get();
+
+  [[nodiscard]] CharClass operator[](char32_t code_point) const {
+    const auto &classes = page(code_point).classes_;
+    const auto offset = (code_point & 0xFF) * 2;
+    return static_cast<CharClass>((classes[offset >> 6] >> (offset & 0x3F)) &
+                                  3);
+  }
+
+  // A combination of Flag
+  [[nodiscard]] std::uint8_t flags(char32_t code_point) const {
+    return page(code_point).flags_[code_point & 0xFF];
+  }
+
+ private:
+  struct Page {
+    // 2 bits each
+    std::array<std::uint64_t, 8> classes_;
+    std::array<std::uint8_t, 256> flags_;
+
+    bool operator==(const Page &) const = default;
+  };
+
+  CharTable();
+
+  [[nodiscard]] const Page &page(char32_t code_point) const {
+    return pages_[page_index_[(code_point >> 8) & 0x1FFF]];
+  }
+
+  std::array<std::uint16_t, 0x2000> page_index_ = {};
+  std::vector<Page> pages_;
+};
+
+struct KEPUB_EXPORT UnknownChar {
+  // Byte offset in the string
+  std::size_t offset_;
+  char32_t code_point_;
+};
+
+struct KEPUB_EXPORT CharCount {
+  std::int32_t cjk_ = 0;
+  std::size_t unknown_ = 0;
+};
+
+// Walk the UTF-8 string in place: count the CJK characters and the unknown
+// ones, the first std::size(unknown) unknown characters are written to unknown
+[[nodiscard]] CharCount KEPUB_EXPORT
+classify(std::string_view str, std::span<UnknownChar> unknown = {});
+
+// The code point at pos, which is moved to the next one. pos must be less than
+// std::size(str)
+[[nodiscard]] char32_t KEPUB_EXPORT next_code_point(std::string_view str,
+                                                    std::size_t &pos);
+
+// The first and the last code point of str, 0 if it is empty
+[[nodiscard]] char32_t KEPUB_EXPORT first_code_point(std::string_view str);
+[[nodiscard]] char32_t KEPUB_EXPORT last_code_point(std::string_view str);
+
+// The same as classify(str).cjk_, but skips ASCII 32 bytes at a time
+[[nodiscard]] std::int32_t KEPUB_EXPORT count_cjk(std::string_view str);
+
+}  // namespace kepub
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "kepub_export.h"
+
+namespace kepub {
+
+// Traditional Chinese to Simplified Chinese with the embedded OpenCC
+// dictionaries, gives the same result as OpenCC tw2s.json. The dictionaries
+// are read-only after construction, so one instance can be shared by all
+// threads
+class KEPUB_EXPORT Converter {
+ public:
+  Converter();
+
+  Converter(const Converter &) = delete;
+  Converter &operator=(const Converter &) = delete;
+
+  ~Converter();
+
+  [[nodiscard]] std::string convert(std::string_view str) const;
+
+  // False only if convert() would return str unchanged
+  [[nodiscard]] bool may_convert(std::string_view str) const;
+
+ private:
+  class Dict;
+
+  [[nodiscard]] bool contains(char32_t code_point) const {
+    const auto &page = pages_[page_index_[code_point >> 8]];
+    return (page[(code_point & 0xFF) >> 6] >> (code_point & 0x3F)) & 1;
+  }
+  void insert(char32_t code_point);
+
+  static void convert_segment(std::string_view segment, const Dict &first,
+                              const Dict &second, std::string &out);
+
+  std::unique_ptr<Dict> ts_phrases_;
+  std::unique_ptr<Dict> ts_characters_;
+  std::unique_ptr<Dict> tw_variants_rev_phrases_;
+  std::unique_ptr<Dict> tw_variants_rev_;
+
+  // A bitset of the code points that can start a change, in pages of 256 bits.
+  // Page 0 is empty and shared by every code point not in the set
+  std::array<std::uint16_t, (0x10FFFF >> 8) + 1> page_index_ = {};
+  std::vector<std::array<std::uint64_t, 4>> pages_;
+};
+
+}  // namespace kepub
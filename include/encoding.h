@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "kepub_export.h"
+
+namespace kepub {
+
+enum class Encoding { Utf8, Gb18030, Big5 };
+
+[[nodiscard]] std::string_view KEPUB_EXPORT encoding_name(Encoding encoding);
+
+// Guess the encoding from the first few KB of a file. UTF-8 if the sample is
+// valid UTF-8 or neither GB18030 nor Big5 can decode it, otherwise the one
+// whose text has more common Chinese characters
+[[nodiscard]] Encoding KEPUB_EXPORT detect_encoding(std::string_view sample);
+
+// Converts GB18030 or Big5 to UTF-8 with iconv. Runs of ASCII are found with
+// AVX2 and copied as they are
+class KEPUB_EXPORT Transcoder {
+ public:
+  explicit Transcoder(Encoding encoding);
+
+  Transcoder(const Transcoder &) = delete;
+  Transcoder &operator=(const Transcoder &) = delete;
+
+  ~Transcoder();
+
+  // Append the UTF-8 of data to out, and return how many bytes are converted.
+  // Only an incomplete character at the end of data is left, it should be
+  // passed again with the data that follows
+  std::size_t transcode(std::string_view data, std::string &out);
+
+ private:
+  Encoding encoding_;
+  void *cd_;
+};
+
+}  // namespace kepub
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <filesystem>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -13,10 +14,18 @@
 
 namespace kepub {
 
+class ZipReader;
+class ZipWriter;
+
 class KEPUB_EXPORT Epub {
  public:
   Epub();
 
+  Epub(const Epub &) = delete;
+  Epub &operator=(const Epub &) = delete;
+
+  ~Epub();
+
   void set_rights(const std::string &rights) { rights_ = rights; }
 
   void set_uuid(const std::string &uuid) {
@@ -31,8 +40,15 @@ class KEPUB_EXPORT Epub {
   void set_novel(const Novel &novel);
 
   void flush_font(const std::string &book_dir);
+  // Append to the book in the directory of the book name, then compress it
   void append();
+  // Append to the .epub file from_epub, and write the result to the .epub file
+  // of the book name. Only package.opf, nav.xhtml and the font are rewritten,
+  // the other entries are copied without being decompressed
+  void append(const std::string &from_epub);
 
+  // Write the .epub file entry by entry. With set_uuid() or set_datetime(),
+  // the book directory is kept for testing and compressed afterwards
   void generate();
 
   constexpr static std::string_view meta_inf_dir = "META-INF";
@@ -57,7 +73,7 @@ class KEPUB_EXPORT Epub {
   constexpr static std::string_view mimetype_path = "mimetype";
 
  private:
-  static void generate_container();
+  void generate_container() const;
   void generate_style() const;
   void generate_image() const;
   void generate_volume() const;
@@ -68,10 +84,22 @@ class KEPUB_EXPORT Epub {
   void generate_postscript() const;
   void generate_nav() const;
   void generate_package() const;
-  static void generate_mimetype();
+  void generate_mimetype() const;
   void generate_font();
 
-  void do_generate_image(const std::filesystem::path &path) const;
+  // The words of every title in the table of contents
+  void collect_font_words() const;
+  void collect_font_words(const pugi::xml_document &nav) const;
+  // Into the ZIP file if there is one, otherwise into the working directory
+  void write(std::string_view path, std::string_view data,
+             bool compress = true) const;
+  void save_file(const pugi::xml_document &doc, std::string_view path) const;
+  // From the ZIP file being appended to if there is one, otherwise from the
+  // working directory
+  [[nodiscard]] pugi::xml_document load_document(std::string_view path) const;
+
+  [[nodiscard]] std::string do_generate_image(
+      const std::filesystem::path &path) const;
   void do_deal_with_nav(pugi::xml_node &ol, std::int32_t first_volume_id,
                         std::int32_t first_chapter_id) const;
   void deal_with_nav(std::int32_t first_volume_id,
@@ -97,6 +125,9 @@ class KEPUB_EXPORT Epub {
 
   mutable std::string font_words_;
   bool debug_ = false;
+
+  std::unique_ptr<ZipReader> zip_reader_;
+  std::unique_ptr<ZipWriter> zip_;
 };
 
 }  // namespace kepub
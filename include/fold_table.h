@@ -0,0 +1,338 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+namespace kepub {
+
+struct FoldEntry {
+  char32_t from_;
+  char32_t to_;
+  bool translation_only_ = false;
+};
+
+// Variants, fullwidth forms and other code points folded by trans_str()
+inline constexpr FoldEntry fold_entries[] = {
+    {U'幺', U'么', true},
+    {U'妳', U'你'},
+    {U'壊', U'坏'},
+    {U'拚', U'拼'},
+    {U'噁', U'恶'},
+    {U'歳', U'岁'},
+    {U'経', U'经'},
+    {U'験', U'验'},
+    {U'険', U'险'},
+    {U'撃', U'击'},
+    {U'錬', U'炼'},
+    {U'隷', U'隶'},
+    {U'毎', U'每'},
+    {U'捩', U'折'},
+    {U'殻', U'壳'},
+    {U'牠', U'它'},
+    {U'矇', U'蒙'},
+    {U'髮', U'发'},
+    {U'姊', U'姐'},
+    {U'黒', U'黑'},
+    {U'歴', U'历'},
+    {U'様', U'样'},
+    {U'甦', U'苏'},
+    {U'牴', U'抵'},
+    {U'銀', U'银'},
+    {U'齢', U'龄'},
+    {U'従', U'从'},
+    {U'酔', U'醉'},
+    {U'値', U'值'},
+    {U'発', U'发'},
+    {U'続', U'续'},
+    {U'転', U'转'},
+    {U'剣', U'剑'},
+    {U'砕', U'碎'},
+    {U'鉄', U'铁'},
+    {U'甯', U'宁'},
+    {U'鬪', U'斗'},
+    {U'寛', U'宽'},
+    {U'変', U'变'},
+    {U'鳮', U'鸡'},
+    {U'悪', U'恶'},
+    {U'霊', U'灵'},
+    {U'戦', U'战'},
+    {U'権', U'权'},
+    {U'効', U'效'},
+    {U'応', U'应'},
+    {U'覚', U'觉'},
+    {U'観', U'观'},
+    {U'気', U'气'},
+    {U'覧', U'览'},
+    {U'殭', U'僵'},
+    {U'郞', U'郎'},
+    {U'虊', U'药'},
+    {U'踼', U'踢'},
+    {U'逹', U'达'},
+    {U'鑜', U'锁'},
+    {U'髲', U'发'},
+    {U'髪', U'发'},
+    {U'実', U'实'},
+    {U'內', U'内'},
+    {U'穨', U'颓'},
+    {U'糸', U'系'},
+    {U'賍', U'赃'},
+    {U'掦', U'扬'},
+    {U'覇', U'霸'},
+    {U'姉', U'姐'},
+    {U'楽', U'乐'},
+    {U'継', U'继'},
+    {U'隠', U'隐'},
+    {U'巻', U'卷'},
+    {U'膞', U'膊'},
+    {U'髑', U'骷'},
+    {U'劄', U'札'},
+    {U'擡', U'抬'},
+    {U'⼈', U'人'},
+    {U'⾛', U'走'},
+    {U'⼤', U'大'},
+    {U'⽤', U'用'},
+    {U'⼿', U'手'},
+    {U'⼦', U'子'},
+    {U'⽽', U'而'},
+    {U'⾄', U'至'},
+    {U'⽯', U'石'},
+    {U'⼗', U'十'},
+    {U'⽩', U'白'},
+    {U'⽗', U'父'},
+    {U'⽰', U'示'},
+    {U'⾁', U'肉'},
+    {U'⼠', U'士'},
+    {U'⽌', U'止'},
+    {U'⼀', U'一'},
+    {U'⺠', U'民'},
+    {U'揹', U'背'},
+    {U'佈', U'布'},
+    {U'勐', U'猛'},
+    {U'嗳', U'哎'},
+    {U'纔', U'才'},
+    {U'繄', U'紧'},
+    {U'勧', U'劝'},
+    {U'鐡', U'铁'},
+    {U'犠', U'牺'},
+    {U'繊', U'纤'},
+    {U'郷', U'乡'},
+    {U'亊', U'事'},
+    {U'騒', U'骚'},
+    {U'聡', U'聪'},
+    {U'遅', U'迟'},
+    {U'唖', U'哑'},
+    {U'獣', U'兽'},
+    {U'読', U'读'},
+    {U'囙', U'因'},
+    {U'寘', U'置'},
+    {U'対', U'对'},
+    {U'処', U'处'},
+    {U'団', U'团'},
+    {U'祢', U'你'},
+    {U'閙', U'闹'},
+    {U'谘', U'咨'},
+    {U'摀', U'捂'},
+    {U'類', U'类'},
+    {U'諷', U'讽'},
+    {U'唿', U'呼'},
+    {U'噹', U'当'},
+    {U'沒', U'没'},
+    {U'別', U'别'},
+    {U'歿', U'殁'},
+    {U'羅', U'罗'},
+    {U'給', U'给'},
+    {U'頽', U'颓'},
+    {U'來', U'来'},
+    {U'裝', U'装'},
+    {U'燈', U'灯'},
+    {U'蓋', U'盖'},
+    {U'迴', U'回'},
+    {U'單', U'单'},
+    {U'勢', U'势'},
+    {U'結', U'结'},
+    {U'砲', U'炮'},
+    {U'採', U'采'},
+    {U'財', U'财'},
+    {U'頂', U'顶'},
+    {U'倆', U'俩'},
+    {U'祕', U'秘'},
+    // https://zh.wikipedia.org/wiki/%E5%85%A8%E5%BD%A2%E5%92%8C%E5%8D%8A%E5%BD%A2
+    {U'＂', U'"'},
+    {U'＃', U'#'},
+    {U'＄', U'$'},
+    {U'％', U'%'},
+    {U'＆', U'&'},
+    {U'＇', U'\''},
+    {U'＊', U'*'},
+    {U'＋', U'+'},
+    {U'．', U'.'},
+    {U'／', U'/'},
+    {U'０', U'0'},
+    {U'１', U'1'},
+    {U'２', U'2'},
+    {U'３', U'3'},
+    {U'４', U'4'},
+    {U'５', U'5'},
+    {U'６', U'6'},
+    {U'７', U'7'},
+    {U'８', U'8'},
+    {U'９', U'9'},
+    {U'＜', U'<'},
+    {U'＝', U'='},
+    {U'＞', U'>'},
+    {U'＠', U'@'},
+    {U'Ａ', U'A'},
+    {U'Ｂ', U'B'},
+    {U'Ｃ', U'C'},
+    {U'Ｄ', U'D'},
+    {U'Ｅ', U'E'},
+    {U'Ｆ', U'F'},
+    {U'Ｇ', U'G'},
+    {U'Ｈ', U'H'},
+    {U'Ｉ', U'I'},
+    {U'Ｊ', U'J'},
+    {U'Ｋ', U'K'},
+    {U'Ｌ', U'L'},
+    {U'Ｍ', U'M'},
+    {U'Ｎ', U'N'},
+    {U'Ｏ', U'O'},
+    {U'Ｐ', U'P'},
+    {U'Ｑ', U'Q'},
+    {U'Ｒ', U'R'},
+    {U'Ｓ', U'S'},
+    {U'Ｔ', U'T'},
+    {U'Ｕ', U'U'},
+    {U'Ｖ', U'V'},
+    {U'Ｗ', U'W'},
+    {U'Ｘ', U'X'},
+    {U'Ｙ', U'Y'},
+    {U'Ｚ', U'Z'},
+    {U'＼', U'\\'},
+    {U'＾', U'^'},
+    {U'｀', U'`'},
+    {U'ａ', U'a'},
+    {U'ｂ', U'b'},
+    {U'ｃ', U'c'},
+    {U'ｄ', U'd'},
+    {U'ｅ', U'e'},
+    {U'ｆ', U'f'},
+    {U'ｇ', U'g'},
+    {U'ｈ', U'h'},
+    {U'ｉ', U'i'},
+    {U'ｊ', U'j'},
+    {U'ｋ', U'k'},
+    {U'ｌ', U'l'},
+    {U'ｍ', U'm'},
+    {U'ｎ', U'n'},
+    {U'ｏ', U'o'},
+    {U'ｐ', U'p'},
+    {U'ｑ', U'q'},
+    {U'ｒ', U'r'},
+    {U'ｓ', U's'},
+    {U'ｔ', U't'},
+    {U'ｕ', U'u'},
+    {U'ｖ', U'v'},
+    {U'ｗ', U'w'},
+    {U'ｘ', U'x'},
+    {U'ｙ', U'y'},
+    {U'ｚ', U'z'},
+    {U'｛', U'{'},
+    {U'｜', U'|'},
+    {U'｝', U'}'},
+    {U'｡', U'。'},
+    {U'｢', U'「'},
+    {U'｣', U'」'},
+    {U'､', U'、'},
+    {U'･', U'·'},
+    {U'•', U'·'},
+    {U'─', U'—'},
+};
+
+namespace detail {
+
+inline constexpr std::size_t fold_page_index_size = 0x110000 >> 8;
+
+constexpr std::size_t fold_page_count() {
+  std::array<bool, fold_page_index_size> base = {};
+  std::array<bool, fold_page_index_size> translation = {};
+
+  // Page 0 maps every code point to itself
+  std::size_t count = 1;
+  for (const auto &entry : fold_entries) {
+    auto &seen = entry.translation_only_ ? translation : base;
+    if (!seen[entry.from_ >> 8]) {
+      seen[entry.from_ >> 8] = true;
+      ++count;
+    }
+  }
+
+  return count;
+}
+
+static_assert(fold_page_count() <= 256);
+
+}  // namespace detail
+
+// Two-level lookup table generated from fold_entries at compile time: a page
+// index for every 256 code points plus dense pages of deltas, so every fold is
+// two array accesses
+class FoldTable {
+ public:
+  constexpr FoldTable() {
+    std::size_t next_page = 1;
+
+    for (const auto &entry : fold_entries) {
+      if (!entry.translation_only_) {
+        auto &page = index_[0][entry.from_ >> 8];
+        if (page == 0) {
+          page = static_cast<std::uint8_t>(next_page++);
+        }
+        auto &delta = pages_[page][entry.from_ & 0xFF];
+        if (delta != 0) {
+          throw "Duplicate fold entry";
+        }
+        delta = make_delta(entry.from_, entry.to_);
+      }
+    }
+
+    index_[1] = index_[0];
+    std::array<bool, detail::fold_page_index_size> copied = {};
+    for (const auto &entry : fold_entries) {
+      if (entry.translation_only_) {
+        const auto high = entry.from_ >> 8;
+        if (!copied[high]) {
+          pages_[next_page] = pages_[index_[0][high]];
+          index_[1][high] = static_cast<std::uint8_t>(next_page++);
+          copied[high] = true;
+        }
+        // Same as folding with the translation-only entry first and then with
+        // the others
+        pages_[index_[1][high]][entry.from_ & 0xFF] =
+            make_delta(entry.from_, fold(entry.to_, false));
+      }
+    }
+  }
+
+  [[nodiscard]] constexpr char32_t fold(char32_t code_point,
+                                        bool translation) const {
+    const auto page = index_[translation][code_point >> 8];
+    return static_cast<char32_t>(static_cast<std::int32_t>(code_point) +
+                                 pages_[page][code_point & 0xFF]);
+  }
+
+ private:
+  constexpr static std::int32_t make_delta(char32_t from, char32_t to) {
+    return static_cast<std::int32_t>(to) - static_cast<std::int32_t>(from);
+  }
+
+  std::array<std::array<std::uint8_t, detail::fold_page_index_size>, 2>
+      index_ = {};
+  std::array<std::array<std::int32_t, 256>, detail::fold_page_count()> pages_ =
+      {};
+};
+
+inline constexpr FoldTable fold_table;
+
+}  // namespace kepub
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <parallel_hashmap/phmap.h>
+
+#include "kepub_export.h"
+
+namespace kepub {
+
+// Multi-pattern replacement over UTF-8 text, built on an Aho-Corasick
+// automaton so that all patterns are applied in a single pass. When several
+// patterns match, the leftmost one wins, then the longest one
+class KEPUB_EXPORT Replacer {
+ public:
+  Replacer();
+  explicit Replacer(
+      const std::vector<std::pair<std::string, std::string>> &replacements);
+
+  [[nodiscard]] bool empty() const { return std::size(to_) == 0; }
+
+  void replace(std::string &str) const;
+
+ private:
+  struct State {
+    std::uint32_t fail_ = 0;
+    // The longest pattern that is a suffix of this state, 0 if none
+    std::uint32_t output_ = 0;
+    std::uint32_t depth_ = 0;
+    std::int32_t pattern_ = -1;
+  };
+
+  [[nodiscard]] static std::uint64_t key(std::uint32_t state,
+                                         std::uint8_t byte) {
+    return (static_cast<std::uint64_t>(state) << 8) | byte;
+  }
+
+  [[nodiscard]] std::uint32_t next(std::uint32_t state,
+                                   std::uint8_t byte) const;
+
+  std::vector<State> states_;
+  std::array<std::uint32_t, 256> root_ = {};
+  phmap::flat_hash_map<std::uint64_t, std::uint32_t> goto_;
+  std::vector<std::string> to_;
+};
+
+}  // namespace kepub
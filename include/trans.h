@@ -1,16 +1,59 @@
 #pragma once
 
+#include <cstdint>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 
 #include "kepub_export.h"
+#include "novel.h"
 
 namespace kepub {
 
+struct KEPUB_EXPORT TransStats {
+  // Lines translated with translation, including those found in the cache
+  std::uint64_t lines_ = 0;
+  // Lines without any character the converter would change, they are only
+  // normalized
+  std::uint64_t skipped_ = 0;
+
+  // Only short lines that go through the converter are cached
+  std::uint64_t cache_hits_ = 0;
+  std::uint64_t cache_misses_ = 0;
+};
+
 std::string KEPUB_EXPORT trans_str(const std::string &str, bool translation);
 
 std::string KEPUB_EXPORT trans_str(std::string_view str, bool translation);
 
 std::string KEPUB_EXPORT trans_str(const char *str, bool translation);
 
+// The same as calling trans_str() on every line, but all lines go through the
+// converter at once
+void KEPUB_EXPORT trans_lines(std::span<std::string> lines, bool translation);
+
+// The same as above, but only the lines that change are allocated and stored in
+// the same position of changed, the others are reset
+void KEPUB_EXPORT trans_lines(std::span<const std::string_view> lines,
+                              std::span<std::optional<std::string>> changed,
+                              bool translation);
+
+// Translate the title and the texts together, texts that become empty are
+// removed
+void KEPUB_EXPORT trans_chapter(Chapter &chapter, bool translation);
+
+// Counted over all translations so far
+TransStats KEPUB_EXPORT trans_stats();
+
+// How many lines skipped the converter, if any line was translated
+void KEPUB_EXPORT log_trans_stats();
+
+// Each line of the file is the string to be replaced and its replacement,
+// separated by a tab. Either may contain spaces and the replacement may be
+// empty. Empty lines and lines starting with '#' are ignored. The string to be
+// replaced is normalized like the text it is matched against, e.g. ',' matches
+// '，'. Must be called before trans_str()
+void KEPUB_EXPORT load_replace_dict(const std::string &file_name);
+
 }  // namespace kepub
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <parallel_hashmap/phmap.h>
+
+#include "kepub_export.h"
+
+namespace kepub {
+
+// Results of trans_str() keyed by a 64-bit hash of the input and the
+// translation flag. The entries are spread over shards with their own mutex,
+// and a shard is emptied when it is full. Only short strings are cached
+class KEPUB_EXPORT TransCache {
+ public:
+  explicit TransCache(std::size_t capacity = 65536);
+
+  [[nodiscard]] std::optional<std::string> get(std::string_view str,
+                                               bool translation);
+  void put(std::string_view str, bool translation, const std::string &result);
+
+  void clear();
+
+  [[nodiscard]] std::uint64_t hits() const;
+  [[nodiscard]] std::uint64_t misses() const;
+
+  constexpr static std::size_t max_str_size = 256;
+
+ private:
+  struct Entry {
+    std::string str_;
+    bool translation_;
+    std::string result_;
+  };
+
+  // Keep every mutex on its own cache line
+  struct alignas(64) Shard {
+    mutable std::mutex mutex_;
+    phmap::flat_hash_map<std::uint64_t, Entry> map_;
+    std::uint64_t hits_ = 0;
+    std::uint64_t misses_ = 0;
+  };
+
+  constexpr static std::size_t shard_count = 64;
+
+  [[nodiscard]] static std::uint64_t hash(std::string_view str,
+                                          bool translation);
+  [[nodiscard]] Shard &shard(std::uint64_t hash) {
+    return shards_[hash % shard_count];
+  }
+
+  std::size_t shard_capacity_;
+  std::array<Shard, shard_count> shards_;
+};
+
+}  // namespace kepub
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "kepub_export.h"
+
+namespace kepub {
+
+// The sections of a TXT file. A prefix is only recognized if its callback is
+// set, otherwise the line is an ordinary line of the current section
+struct KEPUB_EXPORT TxtHandler {
+  // The line after [AUTHOR]
+  std::function<void(std::string author)> author_;
+  // Each line after [INTRO]
+  std::function<void(std::string line)> introduction_;
+  // Each line after [POST]
+  std::function<void(std::string line)> postscript_;
+  // [VOLUME] name
+  std::function<void(std::string name)> volume_;
+  // [WEB] title, then the lines of the chapter
+  std::function<void(std::string title, std::vector<std::string> texts)>
+      chapter_;
+};
+
+// Parse a TXT file incrementally. Lines are translated with trans_lines() and
+// the empty ones removed before they are parsed. Lines are viewed in the data
+// fed, they are only copied if the translation changes them or when they are
+// passed to the handler
+class KEPUB_EXPORT TxtParser {
+ public:
+  TxtParser(TxtHandler handler, bool translation);
+
+  void feed(std::string_view data);
+  // Parse the last line, which may not end with '\n', and end the section
+  void finish();
+
+  // Read the file in chunks and parse it, GB18030 and Big5 are converted to
+  // UTF-8 first
+  void parse_file(const std::string &file_name);
+
+ private:
+  enum class State { None, Author, Introduction, Postscript, Chapter };
+
+  void split_lines(std::string_view data);
+  void flush();
+  void parse_line(std::string_view line, std::optional<std::string> &changed);
+  void end_section();
+
+  TxtHandler handler_;
+  bool translation_;
+
+  std::string buffer_;
+  std::vector<std::string_view> lines_;
+  std::vector<std::optional<std::string>> changed_;
+
+  State state_ = State::None;
+  std::string title_;
+  std::vector<std::string> texts_;
+};
+
+}  // namespace kepub
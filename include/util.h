@@ -1,10 +1,18 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+#include <parallel_hashmap/phmap.h>
+
 #include "kepub_export.h"
 #include "novel.h"
 
@@ -22,17 +30,130 @@ void KEPUB_EXPORT remove_file_or_dir(const std::string &path);
 
 void KEPUB_EXPORT check_is_book_id(const std::string &book_id);
 
-std::vector<std::string> KEPUB_EXPORT
-read_file_to_vec(const std::string &file_name, bool translation);
+struct KEPUB_EXPORT UnknownCharacter {
+  char32_t code_point_;
+  std::uint64_t count_;
+  // The first line it is found in, and where that line is, see location()
+  std::string line_;
+  std::string location_;
+};
+
+// Where a line is in the novel, e.g. "volume 1, chapter 2 '第二章 xxx'", with
+// indices counted from 1
+[[nodiscard]] std::string KEPUB_EXPORT
+location(std::size_t volume_index,
+         std::optional<std::size_t> chapter_index = {},
+         std::string_view title = "");
+
+// Groups the unknown characters found by str_check(), so that they can be
+// reported in one summary. It can be used by many threads
+class KEPUB_EXPORT Diagnostics {
+ public:
+  void add_unknown(char32_t code_point, std::string_view line,
+                   std::uint64_t count = 1, std::string_view location = "");
+
+  // In the order they are first added
+  [[nodiscard]] std::vector<UnknownCharacter> unknown_characters() const;
+
+  void report() const;
+
+ private:
+  struct Item {
+    std::uint64_t count_;
+    std::string line_;
+    std::string location_;
+    std::uint64_t order_;
+  };
+
+  phmap::parallel_flat_hash_map<
+      char32_t, Item, phmap::priv::hash_default_hash<char32_t>,
+      phmap::priv::hash_default_eq<char32_t>,
+      std::allocator<std::pair<const char32_t, Item>>, 4, std::mutex>
+      items_;
+  std::atomic<std::uint64_t> next_order_ = 0;
+};
+
+// Holds the warnings of str_check(), volume_name_check(), title_check() and
+// push_back() on the threads where it is current, so that work done in
+// parallel can report them in order
+class KEPUB_EXPORT WarningBuffer {
+ public:
+  WarningBuffer() = default;
+  // The unknown characters are reported with location, see location()
+  explicit WarningBuffer(std::string location)
+      : location_(std::move(location)) {}
+
+  // Makes the buffer current on this thread until destroyed
+  class KEPUB_EXPORT Scope {
+   public:
+    explicit Scope(WarningBuffer &buffer);
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+    ~Scope();
+
+   private:
+    WarningBuffer *prev_;
+  };
+
+  void add(std::string message);
+  void add_unknown(char32_t code_point, const std::string &line);
+
+  // Print the warnings in order. The unknown characters go to diagnostics if
+  // given, otherwise each one is printed once per process
+  void flush(Diagnostics *diagnostics = nullptr);
+
+ private:
+  struct Warning {
+    std::string message_;
+    // For an unknown character, message_ is the line
+    char32_t code_point_ = 0;
+    std::uint64_t count_ = 0;
+  };
+
+  std::string location_;
+  std::vector<Warning> warnings_;
+  phmap::flat_hash_map<char32_t, std::size_t> unknown_;
+};
 
 void KEPUB_EXPORT str_check(const std::string &str);
 
 std::int32_t KEPUB_EXPORT str_size(const std::string &str);
 
+// 第一卷 xxx, with 1 to 3 numerals
+[[nodiscard]] bool KEPUB_EXPORT is_regular_volume_name(std::string_view str);
+
+// 第一章 xxx or 第一话 xxx, with 1 to 7 numerals
+[[nodiscard]] bool KEPUB_EXPORT is_regular_title(std::string_view str);
+
 void KEPUB_EXPORT volume_name_check(const std::string &volume_name);
 
 void KEPUB_EXPORT title_check(const std::string &title);
 
+struct KEPUB_EXPORT TitleIssue {
+  enum class Kind { IrregularVolumeName, IrregularTitle, UnknownCharacter };
+
+  Kind kind_;
+  std::size_t volume_index_;
+  // Empty if it is about the name of the volume
+  std::optional<std::size_t> chapter_index_;
+  // The volume name or the title
+  std::string text_;
+  // For UnknownCharacter
+  char32_t code_point_ = 0;
+};
+
+// The same checks as volume_name_check() and title_check() for every volume
+// and chapter, done in parallel. Volumes without name are skipped. The result
+// is in the order of the novel
+[[nodiscard]] std::vector<TitleIssue> KEPUB_EXPORT
+check_titles(const Novel &novel);
+
+// Warn about each issue, the unknown characters go to diagnostics if given
+void KEPUB_EXPORT report_title_issues(const std::vector<TitleIssue> &issues,
+                                      Diagnostics *diagnostics = nullptr);
+
 void KEPUB_EXPORT push_back(std::vector<std::string> &texts,
                             const std::string &str, bool connect,
                             bool check = true);
@@ -40,6 +161,27 @@ void KEPUB_EXPORT push_back(std::vector<std::string> &texts,
 void KEPUB_EXPORT push_back(std::vector<std::string> &texts,
                             const std::string &str);
 
+// Joins lines into paragraphs the same way as push_back(), but keeps the text
+// in one buffer that is reused, and only creates the paragraphs in take()
+class KEPUB_EXPORT ParagraphAssembler {
+ public:
+  explicit ParagraphAssembler(bool connect, bool check = true);
+
+  void add(std::string_view line);
+
+  // The paragraphs added so far, then start again
+  [[nodiscard]] std::vector<std::string> take();
+
+ private:
+  bool connect_;
+  bool check_;
+
+  std::string buffer_;
+  std::vector<std::size_t> starts_;
+  // The last code point of the current paragraph
+  char32_t last_ = 0;
+};
+
 std::string KEPUB_EXPORT get_login_name();
 
 std::string KEPUB_EXPORT get_password();
@@ -58,6 +200,71 @@ std::string KEPUB_EXPORT stem(const std::string &path);
 
 std::string KEPUB_EXPORT make_book_name_legal(const std::string &file_name);
 
+// Writes a book in the format of generate_txt() piece by piece, through a
+// fixed size buffer. The book is written to a temporary file, which replaces
+// file_name on close(), so an existing book is kept if writing fails
+class KEPUB_EXPORT TxtWriter {
+ public:
+  explicit TxtWriter(std::string file_name);
+
+  TxtWriter(const TxtWriter &) = delete;
+  TxtWriter &operator=(const TxtWriter &) = delete;
+
+  // Calls close(), unless an exception is thrown, then the temporary file is
+  // removed
+  ~TxtWriter();
+
+  void write_book_info(const BookInfo &book_info);
+  void write_chapter(const std::string &volume_title, const Chapter &chapter);
+
+  // Write what is buffered, except the last byte, it may be the end of the
+  // book
+  void flush();
+  // Write everything left, without the last '\n' of the book, and replace
+  // file_name. Does nothing if already closed
+  void close();
+
+ private:
+  void append(std::string_view str);
+  void write(std::string_view str);
+
+  constexpr static std::size_t buffer_size = 1024 * 1024;
+
+  std::string file_name_;
+  std::string temp_name_;
+  int fd_;
+  int uncaught_exceptions_;
+  bool indent_ = false;
+  std::string buffer_;
+};
+
+// Writes the chapters of volumes to the TXT book of generate_txt() in catalog
+// order while they are still being downloaded. Once every chapter before it is
+// done, a chapter is written and its texts are freed. done() is thread-safe
+class KEPUB_EXPORT OrderedTxtWriter {
+ public:
+  OrderedTxtWriter(const BookInfo &book_info, std::vector<Volume> &volumes);
+
+  void done(std::size_t volume_index, std::size_t chapter_index);
+
+  void close();
+
+ private:
+  struct Item {
+    const std::string *volume_title_;
+    Chapter *chapter_;
+  };
+
+  TxtWriter writer_;
+  std::vector<Item> items_;
+  // The first item of each volume
+  std::vector<std::size_t> offsets_;
+
+  std::mutex mutex_;
+  std::vector<bool> done_;
+  std::size_t next_ = 0;
+};
+
 void KEPUB_EXPORT generate_txt(const BookInfo &book_info,
                                const std::vector<Chapter> &chapters);
 
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "kepub_export.h"
+
+namespace kepub {
+
+// Escape str the same way as pugixml with format_default, and append it to
+// out. Like pugixml, stop at the first null character
+void KEPUB_EXPORT append_escaped_text(std::string &out, std::string_view str);
+
+void KEPUB_EXPORT append_escaped_attribute(std::string &out,
+                                           std::string_view str);
+
+// The XHTML of a chapter, volume, introduction or postscript: the title in an
+// <h1>, then a <p> for each text, or an image for "[IMAGE] xxx". The result is
+// the same as saving the pugixml document with an indent of two spaces, but no
+// DOM is built. If epub_type is not empty, it is set on <body>
+[[nodiscard]] std::string KEPUB_EXPORT
+generate_text_xhtml(std::string_view title,
+                    const std::vector<std::string> &texts,
+                    std::string_view epub_type = "");
+
+}  // namespace kepub
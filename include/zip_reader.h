@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "kepub_export.h"
+
+namespace kepub {
+
+// An entry in the central directory of a ZIP file
+struct KEPUB_EXPORT ZipEntry {
+  std::string path_;
+  std::uint16_t flags_;
+  std::uint16_t method_;
+  std::uint16_t time_;
+  std::uint16_t date_;
+  std::uint32_t crc32_;
+  std::uint32_t compressed_size_;
+  std::uint32_t size_;
+  // Of the local file header
+  std::uint32_t offset_;
+};
+
+// Reads the entries of a ZIP file on demand, either decompressed or as they
+// are stored, so that they can be copied into another ZIP file. Only stored
+// and deflated entries can be decompressed. No ZIP64 and no encryption
+class KEPUB_EXPORT ZipReader {
+ public:
+  explicit ZipReader(const std::string &file_name);
+
+  ZipReader(const ZipReader &) = delete;
+  ZipReader &operator=(const ZipReader &) = delete;
+
+  // In the order of the central directory
+  [[nodiscard]] const std::vector<ZipEntry> &entries() const {
+    return entries_;
+  }
+
+  [[nodiscard]] const ZipEntry *find(std::string_view path) const;
+
+  // The decompressed data of the entry path
+  [[nodiscard]] std::string read(std::string_view path);
+  [[nodiscard]] std::string read(const ZipEntry &entry);
+
+  // The data of the entry as it is stored in the file
+  [[nodiscard]] std::string read_raw(const ZipEntry &entry);
+
+ private:
+  void read_at(std::uint64_t offset, std::string &out, std::size_t size);
+
+  std::string file_name_;
+  std::ifstream ifs_;
+  std::uint64_t file_size_ = 0;
+
+  std::vector<ZipEntry> entries_;
+};
+
+}  // namespace kepub
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "kepub_export.h"
+#include "zip_reader.h"
+
+namespace kepub {
+
+// Writes a ZIP file entry by entry straight from memory. An entry is deflated
+// unless that does not make it smaller. No ZIP64, so the file must be smaller
+// than 4GB
+class KEPUB_EXPORT ZipWriter {
+ public:
+  explicit ZipWriter(const std::string &file_name);
+
+  ZipWriter(const ZipWriter &) = delete;
+  ZipWriter &operator=(const ZipWriter &) = delete;
+
+  // Store data as it is if compress is false, e.g. the mimetype of an EPUB
+  void add(std::string_view path, std::string_view data, bool compress = true);
+
+  // Copy an entry of reader without decompressing it
+  void copy(ZipReader &reader, const ZipEntry &entry);
+
+  // Write the central directory
+  void close();
+
+ private:
+  void write_local_header(const ZipEntry &entry);
+  void write(std::string_view data);
+
+  std::string file_name_;
+  std::ofstream ofs_;
+  std::uint64_t offset_ = 0;
+
+  std::uint16_t time_;
+  std::uint16_t date_;
+
+  std::vector<ZipEntry> entries_;
+  std::string buffer_;
+};
+
+}  // namespace kepub
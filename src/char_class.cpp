@@ -0,0 +1,270 @@
+#include "char_class.h"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <bit>
+
+#include <klib/unicode.h>
+
+namespace kepub {
+
+namespace {
+
+CharClass char_class(char32_t code_point) {
+  if (code_point > 0x10FFFF) {
+    return CharClass::Unknown;
+  }
+
+  if (klib::is_cjk(code_point)) {
+    return CharClass::Cjk;
+  }
+  if (code_point == U'◇' || klib::is_chinese_punctuation(code_point)) {
+    return CharClass::Punctuation;
+  }
+  if (code_point < 0x80 &&
+      ((code_point >= U'0' && code_point <= U'9') ||
+       (code_point >= U'A' && code_point <= U'Z') ||
+       (code_point >= U'a' && code_point <= U'z') || code_point == U' ')) {
+    return CharClass::Ignored;
+  }
+
+  return CharClass::Unknown;
+}
+
+std::uint8_t special_flags(char32_t code_point) {
+  switch (code_point) {
+    case U'—':
+    case U'“':
+    case U'「':
+    case U'『':
+    case U'《':
+    case U'[':
+    case U'【':
+    case U'（':
+      return CharTable::Opening;
+    case U'，':
+      return CharTable::Closing | CharTable::Comma;
+    case U'！':
+    case U'？':
+      return CharTable::Closing | CharTable::Exclamation;
+    case U'。':
+    case U'、':
+    case U'”':
+    case U'」':
+    case U'』':
+    case U'》':
+    case U']':
+    case U'】':
+    case U'）':
+      return CharTable::Closing;
+    default:
+      return 0;
+  }
+}
+
+std::uint8_t char_flags(char32_t code_point) {
+  if (code_point > 0x10FFFF) {
+    return 0;
+  }
+
+  std::uint8_t result = special_flags(code_point);
+  if (klib::is_cjk(code_point)) {
+    result |= CharTable::Cjk;
+  }
+  if (klib::is_chinese_punctuation(code_point)) {
+    result |= CharTable::Punctuation;
+  }
+  if ((code_point >= U'A' && code_point <= U'Z') ||
+      (code_point >= U'a' && code_point <= U'z')) {
+    result |= CharTable::AsciiAlpha | CharTable::AsciiAlnum;
+  }
+  if (code_point >= U'0' && code_point <= U'9') {
+    result |= CharTable::AsciiAlnum;
+  }
+
+  return result;
+}
+
+// Decode the code point at ptr, invalid UTF-8 is one U+FFFD per byte
+char32_t decode(const char *&ptr, const char *last) {
+  const auto lead = static_cast<std::uint8_t>(*ptr);
+
+  std::ptrdiff_t size;
+  char32_t code_point;
+  if (lead < 0x80) {
+    ++ptr;
+    return lead;
+  } else if ((lead & 0xE0) == 0xC0) {
+    size = 2;
+    code_point = lead & 0x1F;
+  } else if ((lead & 0xF0) == 0xE0) {
+    size = 3;
+    code_point = lead & 0x0F;
+  } else if ((lead & 0xF8) == 0xF0) {
+    size = 4;
+    code_point = lead & 0x07;
+  } else {
+    ++ptr;
+    return U'�';
+  }
+
+  if (last - ptr < size) {
+    ++ptr;
+    return U'�';
+  }
+  for (std::ptrdiff_t i = 1; i < size; ++i) {
+    code_point = (code_point << 6) | (static_cast<std::uint8_t>(ptr[i]) & 0x3F);
+  }
+  ptr += size;
+
+  return code_point;
+}
+
+// A bit for each of the 32 bytes that is an ASCII letter, digit or space
+std::uint32_t ignored_mask(const char *ptr) {
+  const auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr));
+  auto in_range = [&](char first, char last) {
+    const auto lower = _mm256_set1_epi8(static_cast<char>(first - 1));
+    const auto upper = _mm256_set1_epi8(static_cast<char>(last + 1));
+    return _mm256_and_si256(_mm256_cmpgt_epi8(bytes, lower),
+                            _mm256_cmpgt_epi8(upper, bytes));
+  };
+
+  const auto mask = _mm256_or_si256(
+      _mm256_or_si256(in_range('0', '9'), in_range('A', 'Z')),
+      _mm256_or_si256(in_range('a', 'z'),
+                      _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '))));
+  return static_cast<std::uint32_t>(_mm256_movemask_epi8(mask));
+}
+
+}  // namespace
+
+const CharTable &CharTable::get() {
+  static const CharTable table;
+  return table;
+}
+
+// Invalid UTF-8 can decode to 0x1FFFFF at most
+CharTable::CharTable() {
+  for (char32_t first = 0; first < 0x200000; first += 256) {
+    Page page = {};
+    for (char32_t i = 0; i < 256; ++i) {
+      const auto offset = i * 2;
+      page.classes_[offset >> 6] |=
+          static_cast<std::uint64_t>(char_class(first + i)) << (offset & 0x3F);
+      page.flags_[i] = char_flags(first + i);
+    }
+
+    auto iter = std::find(std::begin(pages_), std::end(pages_), page);
+    if (iter == std::end(pages_)) {
+      iter = pages_.insert(iter, page);
+    }
+    page_index_[first >> 8] =
+        static_cast<std::uint16_t>(iter - std::begin(pages_));
+  }
+}
+
+CharCount classify(std::string_view str, std::span<UnknownChar> unknown) {
+  const auto &table = CharTable::get();
+
+  CharCount result;
+  const auto *const first = std::data(str);
+  const auto *ptr = first;
+  const auto *const last = ptr + std::size(str);
+
+  while (ptr != last) {
+    if (last - ptr >= 32) {
+      const auto mask = ignored_mask(ptr);
+      if (mask == 0xFFFFFFFF) {
+        ptr += 32;
+        continue;
+      }
+      ptr += std::countr_one(mask);
+    }
+
+    const auto offset = static_cast<std::size_t>(ptr - first);
+    const auto code_point = decode(ptr, last);
+
+    switch (table[code_point]) {
+      case CharClass::Cjk:
+        ++result.cjk_;
+        break;
+      case CharClass::Unknown:
+        if (result.unknown_ < std::size(unknown)) {
+          unknown[result.unknown_] = {offset, code_point};
+        }
+        ++result.unknown_;
+        break;
+      default:
+        break;
+    }
+  }
+
+  return result;
+}
+
+char32_t next_code_point(std::string_view str, std::size_t &pos) {
+  const auto *ptr = std::data(str) + pos;
+  const auto result = decode(ptr, std::data(str) + std::size(str));
+  pos = static_cast<std::size_t>(ptr - std::data(str));
+
+  return result;
+}
+
+char32_t first_code_point(std::string_view str) {
+  if (std::empty(str)) {
+    return 0;
+  }
+
+  const auto *ptr = std::data(str);
+  return decode(ptr, ptr + std::size(str));
+}
+
+char32_t last_code_point(std::string_view str) {
+  if (std::empty(str)) {
+    return 0;
+  }
+
+  auto pos = std::size(str) - 1;
+  for (std::size_t i = 0; i < 3 && pos > 0 &&
+                          (static_cast<std::uint8_t>(str[pos]) & 0xC0) == 0x80;
+       ++i) {
+    --pos;
+  }
+
+  const auto *ptr = std::data(str) + pos;
+  return decode(ptr, std::data(str) + std::size(str));
+}
+
+std::int32_t count_cjk(std::string_view str) {
+  const auto &table = CharTable::get();
+
+  std::int32_t result = 0;
+  const auto *ptr = std::data(str);
+  const auto *const last = ptr + std::size(str);
+
+  while (ptr != last) {
+    // CJK characters are never ASCII
+    if (last - ptr >= 32) {
+      const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr))));
+      if (mask == 0) {
+        ptr += 32;
+        continue;
+      }
+      ptr += std::countr_zero(mask);
+    } else if (static_cast<std::uint8_t>(*ptr) < 0x80) {
+      ++ptr;
+      continue;
+    }
+
+    if (table[decode(ptr, last)] == CharClass::Cjk) {
+      ++result;
+    }
+  }
+
+  return result;
+}
+
+}  // namespace kepub
@@ -0,0 +1,345 @@
+#include "converter.h"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <klib/log.h>
+#include <klib/unicode.h>
+#include <marisa.h>
+
+extern char TSPhrases[];
+extern int TSPhrases_size;
+
+extern char TWVariantsRevPhrases[];
+extern int TWVariantsRevPhrases_size;
+
+extern char TWVariantsRev[];
+extern int TWVariantsRev_size;
+
+extern char TSCharacters[];
+extern int TSCharacters_size;
+
+namespace kepub {
+
+namespace {
+
+// The same as opencc::UTF8Util::NextCharLength(), but never goes past the end
+std::size_t next_char_length(std::string_view str, std::size_t pos) {
+  const auto lead = static_cast<std::uint8_t>(str[pos]);
+
+  std::size_t length = 1;
+  if ((lead & 0xE0) == 0xC0) {
+    length = 2;
+  } else if ((lead & 0xF0) == 0xE0) {
+    length = 3;
+  } else if ((lead & 0xF8) == 0xF0) {
+    length = 4;
+  } else if ((lead & 0xFC) == 0xF8) {
+    length = 5;
+  } else if ((lead & 0xFE) == 0xFC) {
+    length = 6;
+  }
+
+  return std::min(length, std::size(str) - pos);
+}
+
+// The agent only holds the state of the current search, so one per thread can
+// be used with every trie
+marisa::Agent &agent() {
+  thread_local marisa::Agent agent;
+  return agent;
+}
+
+}  // namespace
+
+// An OpenCC .ocd2 file: "OPENCC_MARISA_0.2.5", a marisa trie, then the values
+// of each key in key id order. Only the first value of each key is used, and
+// it points into the blob
+class Converter::Dict {
+ public:
+  struct Match {
+    std::size_t length_ = 0;
+    std::string_view value_;
+  };
+
+  Dict(const char *data, int size) {
+    constexpr std::string_view header = "OPENCC_MARISA_0.2.5";
+    const auto blob_size = static_cast<std::size_t>(size);
+
+    if (blob_size < std::size(header) ||
+        std::memcmp(data, std::data(header), std::size(header)) != 0) {
+      klib::error("Invalid OpenCC dictionary header");
+    }
+
+    std::unique_ptr<std::FILE, decltype(&std::fclose)> file(
+        fmemopen(const_cast<char *>(data), blob_size, "rb"), &std::fclose);
+    if (!file || std::fseek(file.get(), static_cast<long>(std::size(header)),
+                            SEEK_SET) != 0) {
+      klib::error("Failed to open the embedded dictionary");
+    }
+
+    marisa::fread(file.get(), &trie_);
+    auto offset = static_cast<std::size_t>(std::ftell(file.get()));
+
+    auto read = [&]<typename T>(T &value) {
+      if (blob_size - offset < sizeof(T)) {
+        klib::error("Invalid OpenCC dictionary");
+      }
+      std::memcpy(&value, data + offset, sizeof(T));
+      offset += sizeof(T);
+    };
+
+    std::uint32_t num_items;
+    read(num_items);
+    std::uint32_t value_total_length;
+    read(value_total_length);
+    if (blob_size - offset < value_total_length) {
+      klib::error("Invalid OpenCC dictionary");
+    }
+
+    const auto *value = data + offset;
+    const auto *const value_last = value + value_total_length;
+    offset += value_total_length;
+
+    values_.reserve(num_items);
+    for (std::uint32_t i = 0; i < num_items; ++i) {
+      std::uint16_t num_values;
+      read(num_values);
+
+      for (std::uint16_t j = 0; j < num_values; ++j) {
+        // Including the terminating null character
+        std::uint16_t num_value_bytes;
+        read(num_value_bytes);
+        if (num_value_bytes == 0 || value_last - value < num_value_bytes) {
+          klib::error("Invalid OpenCC dictionary");
+        }
+
+        if (j == 0) {
+          values_.emplace_back(value, num_value_bytes - 1);
+        }
+        value += num_value_bytes;
+      }
+
+      // A key without value is converted to itself
+      if (num_values == 0) {
+        values_.emplace_back();
+      }
+    }
+
+    if (std::size(values_) != trie_.num_keys()) {
+      klib::error("Invalid OpenCC dictionary");
+    }
+  }
+
+  // The longest key that is a prefix of str
+  [[nodiscard]] Match match_prefix(std::string_view str) const {
+    auto &agent = kepub::agent();
+    agent.set_query(std::data(str), std::size(str));
+
+    Match match;
+    while (trie_.common_prefix_search(agent)) {
+      match.length_ = agent.key().length();
+      match.value_ = values_[agent.key().id()];
+    }
+
+    if (match.length_ != 0 && std::data(match.value_) == nullptr) {
+      match.value_ = str.substr(0, match.length_);
+    }
+
+    return match;
+  }
+
+  // Call func(key, value) for every key
+  template <typename Func>
+  void for_each(Func func) const {
+    marisa::Agent agent;
+    agent.set_query("");
+
+    while (trie_.predictive_search(agent)) {
+      const std::string_view key(agent.key().ptr(), agent.key().length());
+      const auto value = values_[agent.key().id()];
+      func(key, std::data(value) == nullptr ? key : value);
+    }
+  }
+
+ private:
+  marisa::Trie trie_;
+  std::vector<std::string_view> values_;
+};
+
+Converter::Converter()
+    : ts_phrases_(std::make_unique<Dict>(TSPhrases, TSPhrases_size)),
+      ts_characters_(std::make_unique<Dict>(TSCharacters, TSCharacters_size)),
+      tw_variants_rev_phrases_(std::make_unique<Dict>(
+          TWVariantsRevPhrases, TWVariantsRevPhrases_size)),
+      tw_variants_rev_(
+          std::make_unique<Dict>(TWVariantsRev, TWVariantsRev_size)),
+      pages_(1) {
+  // A key can only be matched if all of its characters are in the text, so one
+  // character of each key that changes the text is enough. Characters are
+  // added first, so that a phrase usually has one of them already
+  for (const auto *dict : {tw_variants_rev_.get(), ts_characters_.get(),
+                           tw_variants_rev_phrases_.get(), ts_phrases_.get()}) {
+    dict->for_each([this](std::string_view key, std::string_view value) {
+      if (key == value) {
+        return;
+      }
+
+      const auto key_utf32 = klib::utf8_to_utf32(key);
+      if (std::any_of(std::begin(key_utf32), std::end(key_utf32),
+                      [this](char32_t c) { return contains(c); })) {
+        return;
+      }
+
+      // The first character that differs
+      const auto value_utf32 = klib::utf8_to_utf32(value);
+      const auto [iter, _] =
+          std::mismatch(std::begin(key_utf32), std::end(key_utf32),
+                        std::begin(value_utf32), std::end(value_utf32));
+      insert(iter == std::end(key_utf32) ? key_utf32.back() : *iter);
+    });
+  }
+
+  if (std::any_of(std::begin(pages_[page_index_[0]]),
+                  std::end(pages_[page_index_[0]]),
+                  [](std::uint64_t bits) { return bits != 0; })) {
+    klib::error("The dictionary contains ASCII characters");
+  }
+}
+
+Converter::~Converter() = default;
+
+// Segment with TSPhrases by maximum matching, every matched phrase is a segment
+// and so is every run of unmatched characters. Then each segment is converted
+// by TWVariantsRevPhrases/TWVariantsRev, then by TSPhrases/TSCharacters
+std::string Converter::convert(std::string_view str) const {
+  thread_local std::string variant;
+
+  std::string result;
+  result.reserve(std::size(str));
+
+  auto convert = [&](std::string_view segment) {
+    if (std::empty(segment)) {
+      return;
+    }
+
+    variant.clear();
+    convert_segment(segment, *tw_variants_rev_phrases_, *tw_variants_rev_,
+                    variant);
+    convert_segment(variant, *ts_phrases_, *ts_characters_, result);
+  };
+
+  std::size_t segment_begin = 0;
+  for (std::size_t pos = 0; pos < std::size(str);) {
+    const auto length = ts_phrases_->match_prefix(str.substr(pos)).length_;
+
+    if (length == 0) {
+      pos += next_char_length(str, pos);
+    } else {
+      convert(str.substr(segment_begin, pos - segment_begin));
+      convert(str.substr(pos, length));
+
+      pos += length;
+      segment_begin = pos;
+    }
+  }
+  convert(str.substr(segment_begin));
+
+  return result;
+}
+
+bool Converter::may_convert(std::string_view str) const {
+  const auto *ptr = std::data(str);
+  const auto *const last = ptr + std::size(str);
+
+  while (ptr != last) {
+    // ASCII is never in the set, skip it 32 bytes at a time
+    if (last - ptr >= 32) {
+      const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr))));
+      if (mask == 0) {
+        ptr += 32;
+        continue;
+      }
+      ptr += std::countr_zero(mask);
+    } else if (static_cast<std::uint8_t>(*ptr) < 0x80) {
+      ++ptr;
+      continue;
+    }
+
+    const auto lead = static_cast<std::uint8_t>(*ptr);
+    std::ptrdiff_t size;
+    char32_t code_point;
+    if ((lead & 0xE0) == 0xC0) {
+      size = 2;
+      code_point = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+      size = 3;
+      code_point = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+      size = 4;
+      code_point = lead & 0x07;
+    } else {
+      // Let the converter deal with invalid UTF-8
+      return true;
+    }
+
+    if (last - ptr < size) {
+      return true;
+    }
+    for (std::ptrdiff_t i = 1; i < size; ++i) {
+      code_point = (code_point << 6) | (static_cast<std::uint8_t>(ptr[i]) & 0x3F);
+    }
+
+    if (code_point > 0x10FFFF || contains(code_point)) {
+      return true;
+    }
+    ptr += size;
+  }
+
+  return false;
+}
+
+void Converter::insert(char32_t code_point) {
+  auto &index = page_index_[code_point >> 8];
+  if (index == 0) {
+    index = static_cast<std::uint16_t>(std::size(pages_));
+    pages_.emplace_back();
+  }
+
+  pages_[index][(code_point & 0xFF) >> 6] |= std::uint64_t(1)
+                                             << (code_point & 0x3F);
+}
+
+// Like opencc::DictGroup, the second dictionary is only used when nothing in
+// the first one matches
+void Converter::convert_segment(std::string_view segment, const Dict &first,
+                                const Dict &second, std::string &out) {
+  for (std::size_t pos = 0; pos < std::size(segment);) {
+    const auto rest = segment.substr(pos);
+
+    auto match = first.match_prefix(rest);
+    if (match.length_ == 0) {
+      match = second.match_prefix(rest);
+    }
+
+    if (match.length_ == 0) {
+      const auto length = next_char_length(segment, pos);
+      out.append(rest.substr(0, length));
+      pos += length;
+    } else {
+      out.append(match.value_);
+      pos += match.length_;
+    }
+  }
+}
+
+}  // namespace kepub
@@ -0,0 +1,197 @@
+#include "encoding.h"
+
+#include <iconv.h>
+#include <immintrin.h>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+#include <klib/log.h>
+#include <simdjson.h>
+
+#include "char_class.h"
+
+namespace kepub {
+
+namespace {
+
+constexpr std::size_t sample_size = 4096;
+
+// Characters that make up a large part of any Chinese text, in both scripts
+constexpr std::u32string_view common_chars =
+    U"的一是不了人我在有他这這个個们們来來说說时時上大中到和你地出也就那要下以"
+    U"生会會着著去之过過家学學可她里裡后後小么麼心多天而能好都然没沒日于於起还"
+    U"還发發成事只作想看文无無手";
+
+const char *iconv_name(Encoding encoding) {
+  switch (encoding) {
+    case Encoding::Gb18030:
+      return "GB18030";
+    case Encoding::Big5:
+      return "BIG5";
+    default:
+      return "UTF-8";
+  }
+}
+
+// The first position from pos where 32 ASCII bytes start, or std::size(data)
+std::size_t find_ascii_block(std::string_view data, std::size_t pos) {
+  for (; pos + 32 <= std::size(data); pos += 32) {
+    const auto mask = static_cast<std::uint32_t>(
+        _mm256_movemask_epi8(_mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(std::data(data) + pos))));
+    if (mask == 0) {
+      return pos;
+    }
+  }
+
+  return std::size(data);
+}
+
+// The number of ASCII bytes at the beginning of data
+std::size_t ascii_prefix(std::string_view data) {
+  std::size_t pos = 0;
+  for (; pos + 32 <= std::size(data); pos += 32) {
+    const auto mask = static_cast<std::uint32_t>(
+        _mm256_movemask_epi8(_mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(std::data(data) + pos))));
+    if (mask != 0) {
+      return pos + static_cast<std::size_t>(std::countr_zero(mask));
+    }
+  }
+
+  while (pos < std::size(data) && static_cast<std::uint8_t>(data[pos]) < 0x80) {
+    ++pos;
+  }
+  return pos;
+}
+
+// Convert data from the beginning of a character, stop at an incomplete
+// character at the end or at an invalid byte. Return the number of bytes
+// converted, and whether the stop is not caused by an invalid byte
+std::pair<std::size_t, bool> convert(iconv_t cd, std::string_view data,
+                                     std::string &out) {
+  std::size_t pos = 0;
+  while (pos < std::size(data)) {
+    // Always at the beginning of a character here
+    if (static_cast<std::uint8_t>(data[pos]) < 0x80) {
+      const auto size = ascii_prefix(data.substr(pos));
+      out.append(data.substr(pos, size));
+      pos += size;
+      continue;
+    }
+
+    // A trail byte can be ASCII, so the first byte of an ASCII block may belong
+    // to the character before it. The byte after it never does
+    const auto last = std::min(find_ascii_block(data, pos) + 1, std::size(data));
+
+    auto *in = const_cast<char *>(std::data(data)) + pos;
+    auto in_left = last - pos;
+
+    // At most 4 bytes of UTF-8 for every byte in
+    const auto out_size = std::size(out);
+    out.resize(out_size + in_left * 4);
+    auto *out_ptr = std::data(out) + out_size;
+    auto out_left = in_left * 4;
+
+    const auto result = iconv(cd, &in, &in_left, &out_ptr, &out_left);
+    out.resize(static_cast<std::size_t>(out_ptr - std::data(out)));
+    pos = static_cast<std::size_t>(in - std::data(data));
+
+    if (result == static_cast<std::size_t>(-1)) {
+      return {pos, errno == EINVAL && last == std::size(data)};
+    }
+  }
+
+  return {pos, true};
+}
+
+bool is_utf8(std::string_view sample) {
+  // The sample may end in the middle of a character
+  for (std::size_t i = 0; i < 4 && i <= std::size(sample); ++i) {
+    const auto str = sample.substr(0, std::size(sample) - i);
+    if (simdjson::validate_utf8(std::data(str), std::size(str))) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// The number of common characters in the sample decoded as encoding, or
+// nothing if it can not be decoded
+std::optional<std::size_t> score(std::string_view sample, Encoding encoding) {
+  const auto cd = iconv_open("UTF-8", iconv_name(encoding));
+  if (cd == reinterpret_cast<iconv_t>(-1)) {
+    return {};
+  }
+
+  std::string utf8;
+  const auto [_, valid] = convert(cd, sample, utf8);
+  iconv_close(cd);
+  if (!valid) {
+    return {};
+  }
+
+  std::size_t result = 0;
+  for (std::size_t pos = 0; pos < std::size(utf8);) {
+    if (common_chars.find(next_code_point(utf8, pos)) !=
+        std::u32string_view::npos) {
+      ++result;
+    }
+  }
+
+  return result;
+}
+
+}  // namespace
+
+std::string_view encoding_name(Encoding encoding) {
+  return iconv_name(encoding);
+}
+
+Encoding detect_encoding(std::string_view sample) {
+  sample = sample.substr(0, sample_size);
+  if (is_utf8(sample)) {
+    return Encoding::Utf8;
+  }
+
+  const auto gb18030 = score(sample, Encoding::Gb18030);
+  const auto big5 = score(sample, Encoding::Big5);
+
+  if (gb18030 && big5) {
+    return *big5 > *gb18030 ? Encoding::Big5 : Encoding::Gb18030;
+  } else if (gb18030) {
+    return Encoding::Gb18030;
+  } else if (big5) {
+    return Encoding::Big5;
+  }
+
+  return Encoding::Utf8;
+}
+
+Transcoder::Transcoder(Encoding encoding)
+    : encoding_(encoding), cd_(iconv_open("UTF-8", iconv_name(encoding))) {
+  if (cd_ == reinterpret_cast<iconv_t>(-1)) {
+    klib::error("Unsupported encoding: {}", iconv_name(encoding));
+  }
+}
+
+Transcoder::~Transcoder() { iconv_close(static_cast<iconv_t>(cd_)); }
+
+std::size_t Transcoder::transcode(std::string_view data, std::string &out) {
+  const auto [size, valid] = convert(static_cast<iconv_t>(cd_), data, out);
+  if (!valid) {
+    klib::error("Invalid {} at byte {}", iconv_name(encoding_), size);
+  }
+
+  return size;
+}
+
+}  // namespace kepub
@@ -1,7 +1,15 @@
 #include "epub.h"
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
 #include <ctime>
+#include <fstream>
 #include <memory>
+#include <optional>
+#include <system_error>
 
 #include <dbg.h>
 #include <fmt/chrono.h>
@@ -9,6 +17,7 @@
 #include <fmt/format.h>
 #include <klib/archive.h>
 #include <klib/font.h>
+#include <klib/hash.h>
 #include <klib/image.h>
 #include <klib/log.h>
 #include <klib/unicode.h>
@@ -20,6 +29,10 @@
 #include <pugixml.hpp>
 
 #include "util.h"
+#include "version.h"
+#include "xhtml.h"
+#include "zip_reader.h"
+#include "zip_writer.h"
 
 extern char font[];
 extern int font_size;
@@ -78,8 +91,7 @@ pugi::xml_document generate_declaration() {
 }
 
 pugi::xml_document generate_xhtml_template(const std::string &title,
-                                           const std::string &div_class = "",
-                                           bool has_h1 = false) {
+                                           const std::string &div_class) {
   auto doc = generate_declaration();
 
   auto html = doc.append_child("html");
@@ -101,44 +113,55 @@ pugi::xml_document generate_xhtml_template(const std::string &title,
     div.append_attribute("class") = div_class.c_str();
   }
 
-  if (has_h1) {
-    auto h1 = div.append_child("h1");
-    h1.text() = title.c_str();
-  }
-
   return doc;
 }
 
-void save_file(const pugi::xml_document &doc, std::string_view path) {
-  const char *space_2 = "  ";
-  if (!doc.save_file(std::data(path), space_2)) {
-    klib::error("Can not save: {}", path);
+class StringWriter : public pugi::xml_writer {
+ public:
+  explicit StringWriter(std::string &str) : str_(str) {}
+
+  void write(const void *data, std::size_t size) override {
+    str_.append(static_cast<const char *>(data), size);
   }
-}
 
-void append_texts(pugi::xml_document &doc,
-                  const std::vector<std::string> &texts) {
-  auto div = doc.select_node("/html/body/div").node();
-  Ensures(!div.empty());
+ private:
+  std::string &str_;
+};
 
-  const static std::string image_prefix = "[IMAGE] ";
-  const static auto image_prefix_size = std::size(image_prefix);
-  for (const auto &text : texts) {
-    if (text.starts_with(image_prefix)) [[unlikely]] {
-      auto image_name = text.substr(image_prefix_size);
+std::string to_string(const pugi::xml_document &doc) {
+  std::string result;
+  StringWriter writer(result);
+  doc.save(writer, "  ");
 
-      auto d = div.append_child("div");
-      d.append_attribute("class") = "center";
-      auto img = d.append_child("img");
+  return result;
+}
 
-      auto stem = kepub::stem(image_name);
-      img.append_attribute("alt") = stem.c_str();
-      img.append_attribute("src") = ("../image/" + stem + ".webp").c_str();
-    } else {
-      auto p = div.append_child("p");
-      p.text() = text.c_str();
-    }
-  }
+// Call generate(i) for every i in [0, count) in parallel, and write(i, result)
+// in order of i. At most max_in_flight results are generated or held at a time
+template <typename Generate, typename Write>
+void generate_in_order(std::size_t count, Generate generate, Write write,
+                       std::size_t max_in_flight = static_cast<std::size_t>(
+                           oneapi::tbb::info::default_concurrency() * 4)) {
+  using Item = std::pair<std::size_t, std::string>;
+
+  std::size_t next = 0;
+  oneapi::tbb::parallel_pipeline(
+      max_in_flight,
+      oneapi::tbb::make_filter<void, std::size_t>(
+          oneapi::tbb::filter_mode::serial_in_order,
+          [&](oneapi::tbb::flow_control &control) -> std::size_t {
+            if (next == count) {
+              control.stop();
+              return 0;
+            }
+            return next++;
+          }) &
+          oneapi::tbb::make_filter<std::size_t, Item>(
+              oneapi::tbb::filter_mode::parallel,
+              [&](std::size_t i) { return Item(i, generate(i)); }) &
+          oneapi::tbb::make_filter<Item, void>(
+              oneapi::tbb::filter_mode::serial_in_order,
+              [&](const Item &item) { write(item.first, item.second); }));
 }
 
 void append_manifest(pugi::xml_node &manifest, const std::string &id,
@@ -191,16 +214,97 @@ std::int32_t last_num(const pugi::xml_node &node, const std::string &prefix,
   return std::empty(ids) ? 0 : ids.back();
 }
 
-void compress_image(const std::string &path) {
-  if (path.ends_with(".webp")) {
+// $XDG_CACHE_HOME/kepub or ~/.cache/kepub, empty if neither can be found. A
+// relative $XDG_CACHE_HOME is ignored, as the XDG specification requires
+std::filesystem::path cache_dir() {
+  if (const auto *dir = std::getenv("XDG_CACHE_HOME");
+      dir != nullptr && std::filesystem::path(dir).is_absolute()) {
+    return std::filesystem::path(dir) / "kepub";
+  }
+  if (const auto *home = std::getenv("HOME");
+      home != nullptr && *home != '\0') {
+    return std::filesystem::path(home) / ".cache" / "kepub";
+  }
+
+  return {};
+}
+
+// The subset only depends on the set of code points and on the embedded font,
+// which can only change with the version
+std::filesystem::path font_cache_path(std::u32string_view code_points) {
+  const auto dir = cache_dir();
+  if (std::empty(dir)) {
+    return {};
+  }
+
+  std::string key(KEPUB_VERSION_STRING);
+  key.append(reinterpret_cast<const char *>(std::data(code_points)),
+             std::size(code_points) * sizeof(char32_t));
+
+  return dir / ("font-" + klib::md5_hex(key) + ".woff2");
+}
+
+// A WOFF2 file starts with "wOF2", and holds its size at offset 8
+bool is_woff2(std::string_view data) {
+  if (std::size(data) < 12 || !data.starts_with("wOF2")) {
+    return false;
+  }
+
+  std::uint32_t size = 0;
+  for (std::size_t i = 8; i < 12; ++i) {
+    size = (size << 8) | static_cast<std::uint8_t>(data[i]);
+  }
+  return size == std::size(data);
+}
+
+std::optional<std::string> read_font_cache(const std::filesystem::path &path) {
+  if (std::empty(path)) {
+    return {};
+  }
+
+  std::error_code error_code;
+  const auto size = std::filesystem::file_size(path, error_code);
+  if (error_code) {
+    return {};
+  }
+
+  std::string result(size, '\0');
+  std::ifstream ifs(path, std::ifstream::binary);
+  ifs.read(std::data(result), static_cast<std::streamsize>(size));
+  if (!ifs || !is_woff2(result)) {
+    return {};
+  }
+
+  return result;
+}
+
+// Failures are ignored, the font is generated again next time. The file is
+// renamed into place, so that other processes never see a partial one
+void write_font_cache(const std::filesystem::path &path,
+                      std::string_view data) {
+  if (std::empty(path)) {
+    return;
+  }
+
+  std::error_code error_code;
+  std::filesystem::create_directories(path.parent_path(), error_code);
+  if (error_code) {
     return;
   }
 
-  auto image_dir = std::filesystem::path(path).parent_path();
-  auto new_file_name = kepub::stem(path) + ".webp";
+  auto temp_path = path;
+  temp_path += "." + klib::uuid() + ".tmp";
+
+  std::ofstream ofs(temp_path, std::ofstream::binary | std::ofstream::trunc);
+  ofs.write(std::data(data), static_cast<std::streamsize>(std::size(data)));
+  ofs.close();
 
-  klib::image_to_webp(path, image_dir / new_file_name);
-  remove_file_or_dir(path);
+  if (ofs) {
+    std::filesystem::rename(temp_path, path, error_code);
+  }
+  if (!ofs || error_code) {
+    std::filesystem::remove(temp_path, error_code);
+  }
 }
 
 }  // namespace
@@ -210,6 +314,8 @@ Epub::Epub() {
   style_ = std::string_view(style, style_size);
 }
 
+Epub::~Epub() = default;
+
 void Epub::set_novel(const Novel &novel) {
   novel_ = novel;
   ready_ = true;
@@ -231,25 +337,7 @@ void Epub::set_novel(const Novel &novel) {
 void Epub::flush_font(const std::string &book_dir) {
   klib::ChangeWorkingDir dir(book_dir);
 
-  pugi::xml_document doc;
-  doc.load_file(std::data(Epub::nav_xhtml_path),
-                pugi::parse_default | pugi::parse_declaration);
-
-  auto ol = doc.select_node("/html/body/nav/ol").node();
-  Ensures(!ol.empty());
-
-  for (const auto &li : ol.children("li")) {
-    auto a = li.child("a");
-    Ensures(!a.empty());
-    font_words_.append(a.text().as_string());
-
-    for (const auto &child_li : li.child("ol")) {
-      auto child_a = child_li.child("a");
-      Ensures(!child_a.empty());
-      font_words_.append(child_a.text().as_string());
-    }
-  }
-
+  collect_font_words(load_document(Epub::nav_xhtml_path));
   generate_font();
 }
 
@@ -264,17 +352,55 @@ void Epub::append() {
   deal_with_nav(first_volume_id, first_chapter_id);
   deal_with_volume(first_volume_id);
   deal_with_chapter(first_chapter_id);
+  generate_font();
 
   dir.reset();
 
-  flush_font(novel_.book_info_.name_);
-
   klib::compress_zip(novel_.book_info_.name_, novel_.book_info_.name_ + ".epub",
                      false);
 
   ready_ = false;
 }
 
+void Epub::append(const std::string &from_epub) {
+  if (!ready_) {
+    klib::error("Call set_novel() first");
+  }
+
+  const auto epub_name = novel_.book_info_.name_ + ".epub";
+  if (std::filesystem::exists(epub_name) &&
+      std::filesystem::equivalent(from_epub, epub_name)) {
+    klib::error("Can not append to '{}' in place", from_epub);
+  }
+
+  zip_reader_ = std::make_unique<ZipReader>(from_epub);
+  zip_ = std::make_unique<ZipWriter>(epub_name);
+
+  // The mimetype must be the first entry and stored, which older books may
+  // not follow
+  generate_mimetype();
+  for (const auto &entry : zip_reader_->entries()) {
+    if (entry.path_ != Epub::mimetype_path &&
+        entry.path_ != Epub::package_opf_path &&
+        entry.path_ != Epub::nav_xhtml_path &&
+        entry.path_ != Epub::font_woff2_path) {
+      zip_->copy(*zip_reader_, entry);
+    }
+  }
+
+  auto [first_volume_id, first_chapter_id] = deal_with_package();
+  deal_with_nav(first_volume_id, first_chapter_id);
+  generate_font();
+  deal_with_volume(first_volume_id);
+  deal_with_chapter(first_chapter_id);
+
+  zip_->close();
+  zip_.reset();
+  zip_reader_.reset();
+
+  ready_ = false;
+}
+
 void Epub::generate() {
   if (!ready_) {
     klib::error("Call set_novel() first");
@@ -291,47 +417,62 @@ void Epub::generate() {
     datetime_ = get_datetime();
   }
 
-  if (std::filesystem::exists(novel_.book_info_.name_)) {
-    remove_file_or_dir(novel_.book_info_.name_);
-  }
+  // Only the words of the titles are needed, so the font can be written
+  // before the XHTML files
+  collect_font_words();
 
-  std::filesystem::create_directory(novel_.book_info_.name_);
-  auto dir = std::make_unique<klib::ChangeWorkingDir>(novel_.book_info_.name_);
+  std::unique_ptr<klib::ChangeWorkingDir> dir;
+  if (debug_) {
+    if (std::filesystem::exists(novel_.book_info_.name_)) {
+      remove_file_or_dir(novel_.book_info_.name_);
+    }
 
-  std::filesystem::create_directory(Epub::meta_inf_dir);
-  std::filesystem::create_directory(Epub::epub_dir);
-  std::filesystem::create_directory(Epub::style_dir);
-  std::filesystem::create_directory(Epub::font_dir);
-  if (!std::empty(novel_.book_info_.cover_path_) ||
-      !std::empty(novel_.image_paths_)) {
-    std::filesystem::create_directory(Epub::image_dir);
+    std::filesystem::create_directory(novel_.book_info_.name_);
+    dir = std::make_unique<klib::ChangeWorkingDir>(novel_.book_info_.name_);
+
+    std::filesystem::create_directory(Epub::meta_inf_dir);
+    std::filesystem::create_directory(Epub::epub_dir);
+    std::filesystem::create_directory(Epub::style_dir);
+    std::filesystem::create_directory(Epub::font_dir);
+    if (!std::empty(novel_.book_info_.cover_path_) ||
+        !std::empty(novel_.image_paths_)) {
+      std::filesystem::create_directory(Epub::image_dir);
+    }
+    std::filesystem::create_directory(Epub::text_dir);
+  } else {
+    zip_ = std::make_unique<ZipWriter>(novel_.book_info_.name_ + ".epub");
   }
-  std::filesystem::create_directory(Epub::text_dir);
 
+  // The mimetype must be the first entry, and stored
+  generate_mimetype();
   generate_container();
   generate_style();
+  generate_font();
   generate_image();
-  generate_volume();
-  generate_chapter();
   generate_cover();
   generate_illustration();
   generate_introduction();
+  generate_volume();
+  generate_chapter();
   generate_postscript();
   generate_nav();
   generate_package();
-  generate_mimetype();
-  generate_font();
 
-  dir.reset();
+  if (debug_) {
+    dir.reset();
 
-  klib::info("Start compressing files");
-  klib::compress_zip(novel_.book_info_.name_, novel_.book_info_.name_ + ".epub",
-                     false);
+    klib::info("Start compressing files");
+    klib::compress_zip(novel_.book_info_.name_,
+                       novel_.book_info_.name_ + ".epub", false);
+  } else {
+    zip_->close();
+    zip_.reset();
+  }
 
   ready_ = false;
 }
 
-void Epub::generate_container() {
+void Epub::generate_container() const {
   auto doc = generate_declaration();
 
   auto container = doc.append_child("container");
@@ -348,7 +489,7 @@ void Epub::generate_container() {
 
 void Epub::generate_style() const {
   Expects(!std::empty(style_));
-  klib::write_file(Epub::style_css_path, false, style_);
+  write(Epub::style_css_path, style_);
 }
 
 void Epub::generate_image() const {
@@ -358,13 +499,25 @@ void Epub::generate_image() const {
   }
   klib::info("Start generating WebP images");
 
+  std::vector<std::string> paths;
   if (!std::empty(novel_.book_info_.cover_path_)) {
-    do_generate_image(novel_.book_info_.cover_path_);
+    paths.push_back(novel_.book_info_.cover_path_);
   }
+  paths.insert(std::end(paths), std::begin(novel_.image_paths_),
+               std::end(novel_.image_paths_));
 
-  oneapi::tbb::parallel_for_each(
-      novel_.image_paths_,
-      [&](const std::string &path) { do_generate_image(path); });
+  // The cover is converted along with the other images. A decoded
+  // illustration can take tens of MB, so only one image per thread is
+  // converted or waits to be written at a time, however many the book has
+  generate_in_order(
+      std::size(paths),
+      [&](std::size_t i) { return do_generate_image(paths[i]); },
+      [&](std::size_t i, const std::string &image) {
+        write(std::string(Epub::image_dir) + "/" + kepub::stem(paths[i]) +
+                  ".webp",
+              image);
+      },
+      static_cast<std::size_t>(oneapi::tbb::info::default_concurrency()));
 }
 
 void Epub::generate_volume() const { deal_with_volume(1); }
@@ -373,9 +526,7 @@ void Epub::generate_chapter() const { deal_with_chapter(1); }
 
 void Epub::generate_cover() const {
   if (!std::empty(novel_.book_info_.cover_path_)) {
-    font_words_.append("封面");
-
-    auto doc = generate_xhtml_template("封面", "cover", false);
+    auto doc = generate_xhtml_template("封面", "cover");
 
     auto body = doc.select_node("/html/body").node();
     Ensures(!body.empty());
@@ -396,9 +547,8 @@ void Epub::generate_cover() const {
 void Epub::generate_illustration() const {
   for (std::int32_t i = 1; i <= novel_.illustration_num_; ++i) {
     auto title = "彩页 " + std::to_string(i);
-    font_words_.append(title);
 
-    auto doc = generate_xhtml_template(title, "center", false);
+    auto doc = generate_xhtml_template(title, "center");
     auto file_name = num_to_illustration_name(i);
 
     auto div = doc.select_node("/html/body/div").node();
@@ -409,38 +559,22 @@ void Epub::generate_illustration() const {
     img.append_attribute("alt") = num_str.c_str();
     img.append_attribute("src") = ("../image/" + num_str + ".webp").c_str();
 
-    auto path = std::filesystem::path(Epub::text_dir) / file_name;
-    save_file(doc, path.c_str());
+    save_file(doc, std::string(Epub::text_dir) + "/" + file_name);
   }
 }
 
 void Epub::generate_introduction() const {
   if (!std::empty(novel_.book_info_.introduction_)) {
-    font_words_.append("简介");
-
-    auto doc = generate_xhtml_template("简介", "", true);
-
-    auto body = doc.select_node("/html/body").node();
-    Ensures(!body.empty());
-    body.append_attribute("epub:type") = "introduction";
-
-    append_texts(doc, novel_.book_info_.introduction_);
-    save_file(doc, Epub::introduction_xhtml_path);
+    write(Epub::introduction_xhtml_path,
+          generate_text_xhtml("简介", novel_.book_info_.introduction_,
+                              "introduction"));
   }
 }
 
 void Epub::generate_postscript() const {
   if (!std::empty(novel_.postscript_)) {
-    font_words_.append("后记");
-
-    auto doc = generate_xhtml_template("后记", "", true);
-
-    auto body = doc.select_node("/html/body").node();
-    Ensures(!body.empty());
-    body.append_attribute("epub:type") = "afterword";
-
-    append_texts(doc, novel_.postscript_);
-    save_file(doc, Epub::postscript_xhtml_path);
+    write(Epub::postscript_xhtml_path,
+          generate_text_xhtml("后记", novel_.postscript_, "afterword"));
   }
 }
 
@@ -622,9 +756,8 @@ void Epub::generate_package() const {
   save_file(doc, Epub::package_opf_path);
 }
 
-void Epub::generate_mimetype() {
-  std::string_view text = "application/epub+zip";
-  klib::write_file(Epub::mimetype_path, false, text);
+void Epub::generate_mimetype() const {
+  write(Epub::mimetype_path, "application/epub+zip", false);
 }
 
 void Epub::generate_font() {
@@ -633,21 +766,115 @@ void Epub::generate_font() {
   klib::info("Start generating WOFF2 font");
 
   dbg(font_words_);
-  auto ttf_font = klib::ttf_subset(font_, klib::utf8_to_utf32(font_words_));
+  // Each code point once, which gives the same subset with less work
+  auto code_points = klib::utf8_to_utf32(font_words_);
+  boost::sort::pdqsort(std::begin(code_points), std::end(code_points));
+  code_points.erase(
+      std::unique(std::begin(code_points), std::end(code_points)),
+      std::end(code_points));
+
+  // Encoding WOFF2 is slow, and many books share the same characters
+  const auto cache_path = font_cache_path(code_points);
+  if (auto woff2_font = read_font_cache(cache_path)) {
+    write(Epub::font_woff2_path, *woff2_font);
+    return;
+  }
+
+  auto ttf_font = klib::ttf_subset(font_, code_points);
   auto woff2_font = klib::ttf_to_woff2(ttf_font);
-  klib::write_file(Epub::font_woff2_path, true, woff2_font);
+  write_font_cache(cache_path, woff2_font);
+  write(Epub::font_woff2_path, woff2_font);
+}
+
+void Epub::collect_font_words() const {
+  if (!std::empty(novel_.book_info_.cover_path_)) {
+    font_words_.append("封面");
+  }
+  for (std::int32_t i = 1; i <= novel_.illustration_num_; ++i) {
+    font_words_.append("彩页 " + std::to_string(i));
+  }
+  if (!std::empty(novel_.book_info_.introduction_)) {
+    font_words_.append("简介");
+  }
+  if (!std::empty(novel_.postscript_)) {
+    font_words_.append("后记");
+  }
+
+  for (const auto &volume : novel_.volumes_) {
+    font_words_.append(volume.title_);
+    for (const auto &chapter : volume.chapters_) {
+      font_words_.append(chapter.title_);
+    }
+  }
 }
 
-void Epub::do_generate_image(const std::filesystem::path &path) const {
-  const static std::filesystem::path image_dir(Epub::image_dir);
+void Epub::collect_font_words(const pugi::xml_document &nav) const {
+  auto ol = nav.select_node("/html/body/nav/ol").node();
+  Ensures(!ol.empty());
+
+  for (const auto &li : ol.children("li")) {
+    auto a = li.child("a");
+    Ensures(!a.empty());
+    font_words_.append(a.text().as_string());
 
+    for (const auto &child_li : li.child("ol")) {
+      auto child_a = child_li.child("a");
+      Ensures(!child_a.empty());
+      font_words_.append(child_a.text().as_string());
+    }
+  }
+}
+
+void Epub::write(std::string_view path, std::string_view data,
+                 bool compress) const {
+  if (zip_) {
+    zip_->add(path, data, compress);
+  } else {
+    klib::write_file(path, true, data);
+  }
+}
+
+void Epub::save_file(const pugi::xml_document &doc,
+                     std::string_view path) const {
+  write(path, to_string(doc));
+}
+
+pugi::xml_document Epub::load_document(std::string_view path) const {
+  pugi::xml_document doc;
+
+  if (zip_reader_) {
+    const auto data = zip_reader_->read(path);
+    doc.load_buffer(std::data(data), std::size(data),
+                    pugi::parse_default | pugi::parse_declaration);
+  } else {
+    doc.load_file(std::string(path).c_str(),
+                  pugi::parse_default | pugi::parse_declaration);
+  }
+
+  return doc;
+}
+
+std::string Epub::do_generate_image(const std::filesystem::path &path) const {
   Expects(std::filesystem::exists(path));
 
-  auto file_name = path.filename();
-  auto image_path = image_dir / file_name;
-  std::filesystem::copy(path, image_path);
+  if (path.extension() == ".webp") {
+    return klib::read_file(path.string(), true);
+  }
+
+  // Books generated at the same time may share the UUID and the image names
+  auto webp_path =
+      (std::filesystem::temp_directory_path() / "kepub-XXXXXX.webp").string();
+  const auto fd = ::mkstemps(std::data(webp_path), 5);
+  if (fd == -1) {
+    klib::error("Failed to create temporary file: '{}'", webp_path);
+  }
+  ::close(fd);
+  klib::image_to_webp(path, webp_path);
+
+  auto result = klib::read_file(webp_path, true);
+  remove_file_or_dir(webp_path);
 
-  compress_image(image_path);
+  return result;
 }
 
 void Epub::do_deal_with_nav(pugi::xml_node &ol, std::int32_t first_volume_id,
@@ -656,8 +883,6 @@ void Epub::do_deal_with_nav(pugi::xml_node &ol, std::int32_t first_volume_id,
     pugi::xml_node node;
 
     if (!std::empty(volume.title_)) {
-      font_words_.append(volume.title_);
-
       auto li = ol.append_child("li");
       auto a = li.append_child("a");
       a.append_attribute("href") =
@@ -674,8 +899,6 @@ void Epub::do_deal_with_nav(pugi::xml_node &ol, std::int32_t first_volume_id,
     }
 
     for (const auto &chapter : volume.chapters_) {
-      font_words_.append(chapter.title_);
-
       auto chapter_li = node.append_child("li");
       auto chapter_a = chapter_li.append_child("a");
       chapter_a.append_attribute("href") =
@@ -687,14 +910,13 @@ void Epub::do_deal_with_nav(pugi::xml_node &ol, std::int32_t first_volume_id,
 
 void Epub::deal_with_nav(std::int32_t first_volume_id,
                          std::int32_t first_chapter_id) const {
-  pugi::xml_document doc;
-  doc.load_file(std::data(Epub::nav_xhtml_path),
-                pugi::parse_default | pugi::parse_declaration);
+  auto doc = load_document(Epub::nav_xhtml_path);
 
   auto ol = doc.select_node("/html/body/nav/ol").node();
   Ensures(!ol.empty());
 
   do_deal_with_nav(ol, first_volume_id, first_chapter_id);
+  collect_font_words(doc);
 
   save_file(doc, Epub::nav_xhtml_path);
 }
@@ -718,9 +940,7 @@ void Epub::do_deal_with_package(pugi::xml_node &manifest,
 }
 
 std::pair<std::int32_t, std::int32_t> Epub::deal_with_package() const {
-  pugi::xml_document doc;
-  doc.load_file(std::data(Epub::package_opf_path),
-                pugi::parse_default | pugi::parse_declaration);
+  auto doc = load_document(Epub::package_opf_path);
 
   auto manifest = doc.select_node("/package/manifest").node();
   auto first_volume_id = last_num(doc, "volume", ".xhtml") + 1;
@@ -740,30 +960,48 @@ std::pair<std::int32_t, std::int32_t> Epub::deal_with_package() const {
   return {first_volume_id, first_chapter_id};
 }
 
+// The file names only depend on the position, so the documents are generated
+// in parallel and written in the same order as before
 void Epub::deal_with_volume(std::int32_t first_volume_id) const {
-  const static std::filesystem::path text_path(Epub::text_dir);
-
+  std::vector<const Volume *> volumes;
   for (const auto &volume : novel_.volumes_) {
     if (!std::empty(volume.title_)) {
-      auto doc = generate_xhtml_template(volume.title_, "", true);
-      auto path = text_path / num_to_volume_name(first_volume_id++);
-      save_file(doc, path.c_str());
+      volumes.push_back(&volume);
     }
   }
+
+  generate_in_order(
+      std::size(volumes),
+      [&](std::size_t i) {
+        return generate_text_xhtml(volumes[i]->title_, {});
+      },
+      [&](std::size_t i, const std::string &xhtml) {
+        write(std::string(Epub::text_dir) + "/" +
+                  num_to_volume_name(first_volume_id +
+                                     static_cast<std::int32_t>(i)),
+              xhtml);
+      });
 }
 
 void Epub::deal_with_chapter(std::int32_t first_chapter_id) const {
-  const static std::filesystem::path text_path(Epub::text_dir);
-
+  std::vector<const Chapter *> chapters;
   for (const auto &volume : novel_.volumes_) {
     for (const auto &chapter : volume.chapters_) {
-      auto doc = generate_xhtml_template(chapter.title_, "", true);
-      append_texts(doc, chapter.texts_);
-
-      auto path = text_path / num_to_chapter_name(first_chapter_id++);
-      save_file(doc, path.c_str());
+      chapters.push_back(&chapter);
     }
   }
+
+  generate_in_order(
+      std::size(chapters),
+      [&](std::size_t i) {
+        return generate_text_xhtml(chapters[i]->title_, chapters[i]->texts_);
+      },
+      [&](std::size_t i, const std::string &xhtml) {
+        write(std::string(Epub::text_dir) + "/" +
+                  num_to_chapter_name(first_chapter_id +
+                                      static_cast<std::int32_t>(i)),
+              xhtml);
+      });
 }
 
 }  // namespace kepub
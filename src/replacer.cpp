@@ -0,0 +1,147 @@
+#include "replacer.h"
+
+#include <cstddef>
+#include <utility>
+
+#include <klib/log.h>
+
+namespace kepub {
+
+Replacer::Replacer() : states_(1) {}
+
+Replacer::Replacer(
+    const std::vector<std::pair<std::string, std::string>> &replacements)
+    : states_(1) {
+  std::vector<std::vector<std::pair<std::uint8_t, std::uint32_t>>> children(1);
+
+  for (const auto &[from, to] : replacements) {
+    if (std::empty(from)) {
+      klib::error("The string to be replaced is empty");
+    }
+
+    std::uint32_t state = 0;
+    for (auto c : from) {
+      const auto byte = static_cast<std::uint8_t>(c);
+
+      std::uint32_t child = 0;
+      if (state == 0) {
+        child = root_[byte];
+      } else if (auto iter = goto_.find(key(state, byte));
+                 iter != std::end(goto_)) {
+        child = iter->second;
+      }
+
+      if (child == 0) {
+        child = static_cast<std::uint32_t>(std::size(states_));
+        states_.push_back({.depth_ = states_[state].depth_ + 1});
+        children.emplace_back();
+        children[state].emplace_back(byte, child);
+
+        if (state == 0) {
+          root_[byte] = child;
+        } else {
+          goto_.emplace(key(state, byte), child);
+        }
+      }
+
+      state = child;
+    }
+
+    // Later replacements take precedence
+    if (states_[state].pattern_ == -1) {
+      states_[state].pattern_ = static_cast<std::int32_t>(std::size(to_));
+      to_.push_back(to);
+    } else {
+      to_[states_[state].pattern_] = to;
+    }
+  }
+
+  // Breadth-first, so the fail link of a state is always computed before its
+  // children need it
+  std::vector<std::uint32_t> queue;
+  queue.reserve(std::size(states_));
+  for (auto [byte, child] : children.front()) {
+    queue.push_back(child);
+  }
+
+  for (std::size_t i = 0; i < std::size(queue); ++i) {
+    const auto state = queue[i];
+    auto &item = states_[state];
+    item.output_ = item.pattern_ != -1 ? state : states_[item.fail_].output_;
+
+    for (auto [byte, child] : children[state]) {
+      states_[child].fail_ = next(item.fail_, byte);
+      queue.push_back(child);
+    }
+  }
+}
+
+void Replacer::replace(std::string &str) const {
+  if (empty()) {
+    return;
+  }
+
+  std::string result;
+  std::size_t copied = 0;
+
+  std::uint32_t state = 0;
+  // The leftmost-longest match found so far
+  std::int32_t match = -1;
+  std::size_t match_begin = 0;
+  std::size_t match_end = 0;
+
+  const auto size = std::size(str);
+  for (std::size_t i = 0;;) {
+    if (i < size) {
+      state = next(state, static_cast<std::uint8_t>(str[i]));
+      ++i;
+
+      // Only the longest output can start further left
+      if (const auto output = states_[state].output_; output != 0) {
+        const auto begin = i - states_[output].depth_;
+        if (match == -1 || begin <= match_begin) {
+          match = states_[output].pattern_;
+          match_begin = begin;
+          match_end = i;
+        }
+      }
+
+      // Any later match starts at or after i - depth, so the match can only be
+      // replaced while it does not start before that
+      if (match == -1 || match_begin + states_[state].depth_ >= i) {
+        continue;
+      }
+    } else if (match == -1) {
+      break;
+    }
+
+    result.append(str, copied, match_begin - copied);
+    result.append(to_[match]);
+
+    // Matches must not overlap, so scan again right after the replaced one
+    copied = match_end;
+    i = match_end;
+    state = 0;
+    match = -1;
+  }
+
+  if (copied == 0) {
+    return;
+  }
+
+  result.append(str, copied);
+  str = std::move(result);
+}
+
+std::uint32_t Replacer::next(std::uint32_t state, std::uint8_t byte) const {
+  while (state != 0) {
+    if (auto iter = goto_.find(key(state, byte)); iter != std::end(goto_)) {
+      return iter->second;
+    }
+    state = states_[state].fail_;
+  }
+
+  return root_[byte];
+}
+
+}  // namespace kepub
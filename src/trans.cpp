@@ -1,55 +1,225 @@
 #include "trans.h"
 
+#include <immintrin.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include <klib/log.h>
 #include <klib/unicode.h>
 #include <klib/util.h>
-#include <opencc.h>
-#include <parallel_hashmap/phmap.h>
-#include <boost/algorithm/string.hpp>
 
-extern char tw2s[];
-extern int tw2s_size;
+#include "converter.h"
+#include "fold_table.h"
+#include "replacer.h"
+#include "trans_cache.h"
+#include "util.h"
 
-extern char TSPhrases[];
-extern int TSPhrases_size;
+namespace kepub {
 
-extern char TWVariantsRevPhrases[];
-extern int TWVariantsRevPhrases_size;
+namespace {
 
-extern char TWVariantsRev[];
-extern int TWVariantsRev_size;
+std::vector<std::pair<std::string, std::string>> &user_replacements() {
+  static std::vector<std::pair<std::string, std::string>> replacements;
+  return replacements;
+}
 
-extern char TSCharacters[];
-extern int TSCharacters_size;
+void fold(std::string_view str, bool translation, std::string &result);
 
-namespace kepub {
+Replacer make_replacer(bool translation) {
+  std::vector<std::pair<std::string, std::string>> replacements = {
+      {"赤果果", "赤裸裸"}, {"赤果", "赤裸"}, {"廿", "二十"}, {"卅", "三十"}};
+  if (translation) {
+    replacements.emplace_back("颠复", "颠覆");
+  }
 
-namespace {
+  // Replacements apply to folded text, so a key with e.g. ASCII punctuation
+  // must be folded the same way to ever match
+  for (const auto &[from, to] : user_replacements()) {
+    std::string key;
+    fold(from, translation, key);
+    replacements.emplace_back(std::move(key), to);
+  }
+
+  return Replacer(replacements);
+}
+
+Replacer &get_replacer(bool translation) {
+  static Replacer replacers[] = {make_replacer(false), make_replacer(true)};
+  return replacers[translation];
+}
+
+bool is_ascii_alnum(char c) {
+  return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') ||
+         (c >= 'a' && c <= 'z');
+}
+
+// Number of leading ASCII letters and digits in [first, last), these bytes are
+// never changed by custom_trans()
+std::size_t ascii_alnum_prefix(const char *first, const char *last) {
+  const auto *ptr = first;
+
+  for (; last - ptr >= 32; ptr += 32) {
+    const auto bytes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr));
+    const auto lower = _mm256_or_si256(bytes, _mm256_set1_epi8(0x20));
+
+    const auto alpha =
+        _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                         _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+    const auto digit =
+        _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('0' - 1)),
+                         _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), bytes));
+
+    const auto mask = static_cast<std::uint32_t>(
+        _mm256_movemask_epi8(_mm256_or_si256(alpha, digit)));
+    if (mask != 0xFFFFFFFF) {
+      return static_cast<std::size_t>(ptr - first) + std::countr_one(mask);
+    }
+  }
+
+  while (ptr != last && is_ascii_alnum(*ptr)) {
+    ++ptr;
+  }
+
+  return static_cast<std::size_t>(ptr - first);
+}
+
+constexpr char32_t invalid_code_point = 0xFFFFFFFF;
+
+// Decode the code point at ptr and advance ptr past it, invalid_code_point if
+// the sequence is truncated or malformed
+char32_t decode_utf8(const char *&ptr, const char *last) {
+  const auto lead = static_cast<std::uint8_t>(*ptr);
+
+  std::size_t size;
+  char32_t code_point;
+  char32_t min;
+  if (lead < 0x80) {
+    ++ptr;
+    return lead;
+  } else if ((lead & 0xE0) == 0xC0) {
+    size = 2;
+    code_point = lead & 0x1F;
+    min = 0x80;
+  } else if ((lead & 0xF0) == 0xE0) {
+    size = 3;
+    code_point = lead & 0x0F;
+    min = 0x800;
+  } else if ((lead & 0xF8) == 0xF0) {
+    size = 4;
+    code_point = lead & 0x07;
+    min = 0x10000;
+  } else {
+    return invalid_code_point;
+  }
+
+  if (static_cast<std::size_t>(last - ptr) < size) {
+    return invalid_code_point;
+  }
+
+  for (std::size_t i = 1; i < size; ++i) {
+    const auto byte = static_cast<std::uint8_t>(ptr[i]);
+    if ((byte & 0xC0) != 0x80) {
+      return invalid_code_point;
+    }
+    code_point = (code_point << 6) | (byte & 0x3F);
+  }
+
+  if (code_point < min || code_point > 0x10FFFF ||
+      (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+    return invalid_code_point;
+  }
+
+  ptr += size;
+  return code_point;
+}
+
+char *encode_utf8(char32_t code_point, char *out) {
+  if (code_point < 0x80) {
+    *out++ = static_cast<char>(code_point);
+  } else if (code_point < 0x800) {
+    *out++ = static_cast<char>(0xC0 | (code_point >> 6));
+    *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+  } else if (code_point < 0x10000) {
+    *out++ = static_cast<char>(0xE0 | (code_point >> 12));
+    *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+  } else {
+    *out++ = static_cast<char>(0xF0 | (code_point >> 18));
+    *out++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+    *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+  }
+
+  return out;
+}
 
-class Converter {
- public:
-  Converter() {
-    klib::write_file("/tmp/tw2s.json", false, tw2s, tw2s_size);
-    klib::write_file("/tmp/TSPhrases.ocd2", true, TSPhrases, TSPhrases_size);
-    klib::write_file("/tmp/TWVariantsRevPhrases.ocd2", true,
-                     TWVariantsRevPhrases, TWVariantsRevPhrases_size);
-    klib::write_file("/tmp/TWVariantsRev.ocd2", true, TWVariantsRev,
-                     TWVariantsRev_size);
-    klib::write_file("/tmp/TSCharacters.ocd2", true, TSCharacters,
-                     TSCharacters_size);
+// The last code point of the valid UTF-8 in [first, last), 0 if it is empty
+char32_t last_code_point(const char *first, const char *last) {
+  if (first == last) {
+    return 0;
   }
 
-  [[nodiscard]] std::string convert(const std::string &str) const {
-    const static opencc::SimpleConverter converter("/tmp/tw2s.json");
-    return converter.Convert(str);
+  auto ptr = last - 1;
+  while (ptr != first && (static_cast<std::uint8_t>(*ptr) & 0xC0) == 0x80) {
+    --ptr;
   }
-};
 
-std::u32string custom_trans(const std::u32string &str, bool translation) {
-  std::u32string result;
-  result.reserve(std::size(str));
+  return decode_utf8(ptr, last);
+}
+
+bool ends_with(const char *first, const char *last, std::string_view suffix) {
+  return static_cast<std::size_t>(last - first) >= std::size(suffix) &&
+         std::memcmp(last - std::size(suffix), std::data(suffix),
+                     std::size(suffix)) == 0;
+}
+
+// Decode, normalize punctuation and whitespace and fold variants in one pass,
+// writing UTF-8 straight into the result
+void fold(std::string_view str, bool translation, std::string &result) {
+  // At most one ASCII byte becomes three bytes, e.g. '?' -> '？'
+  result.resize(std::size(str) * 3);
+
+  auto *const begin = std::data(result);
+  auto *out = begin;
+  // The last code point written to result
+  char32_t back = 0;
+
+  auto push_back = [&](char32_t code_point) {
+    out = encode_utf8(code_point, out);
+    back = code_point;
+  };
+  auto erase_tail = [&](std::size_t n) {
+    out -= n;
+    back = last_code_point(begin, out);
+  };
 
   constexpr auto space = U' ';
-  for (const auto code_point : str) {
+  const auto *ptr = std::data(str);
+  const auto *const last = ptr + std::size(str);
+  while (ptr != last) {
+    if (is_ascii_alnum(*ptr)) [[unlikely]] {
+      const auto size = ascii_alnum_prefix(ptr, last);
+      std::memcpy(out, ptr, size);
+      out += size;
+      ptr += size;
+      back = static_cast<char32_t>(out[-1]);
+      continue;
+    }
+
+    const auto code_point = decode_utf8(ptr, last);
+    if (code_point == invalid_code_point) [[unlikely]] {
+      klib::error("Invalid UTF-8: {}", str);
+    }
+
     if (
         // https://en.wikipedia.org/wiki/Zero-width_space
         code_point == U'\u200B' ||
@@ -64,359 +234,329 @@ std::u32string custom_trans(const std::u32string &str, bool translation) {
     }
 
     if (klib::is_whitespace(code_point)) {
-      if (!std::empty(result) && !klib::is_chinese_punctuation(result.back())) {
-        result.push_back(space);
+      if (out != begin && !klib::is_chinese_punctuation(back)) {
+        push_back(space);
       }
     } else if (klib::is_chinese_punctuation(code_point) ||
                klib::is_english_punctuation(code_point)) {
-      if (!std::empty(result) && result.back() == space) [[unlikely]] {
-        result.pop_back();
+      if (out != begin && back == space) [[unlikely]] {
+        erase_tail(1);
       }
 
       if (code_point == U'?') {
-        result.push_back(U'？');
+        push_back(U'？');
       } else if (code_point == U'!') {
-        result.push_back(U'！');
+        push_back(U'！');
       } else if (code_point == U',') {
-        result.push_back(U'，');
+        push_back(U'，');
       } else if (code_point == U':') {
-        result.push_back(U'：');
+        push_back(U'：');
       } else if (code_point == U';') {
         // https://zh.wikipedia.org/wiki/%E4%B8%8D%E6%8D%A2%E8%A1%8C%E7%A9%BA%E6%A0%BC
-        if (result.ends_with(U"&nbsp")) [[unlikely]] {
-          boost::erase_tail(result, 5);
-          result.push_back(U' ');
+        if (ends_with(begin, out, "&nbsp")) [[unlikely]] {
+          erase_tail(5);
+          push_back(U' ');
         }  // https://pugixml.org/docs/manual.html#loading.options
-        else if (result.ends_with(U"&lt")) [[unlikely]] {
-          boost::erase_tail(result, 3);
-          result.push_back(U'<');
-        } else if (result.ends_with(U"&gt")) [[unlikely]] {
-          boost::erase_tail(result, 3);
-          result.push_back(U'>');
-        } else if (result.ends_with(U"&quot")) [[unlikely]] {
-          boost::erase_tail(result, 5);
-          result.push_back(U'"');
-        } else if (result.ends_with(U"&apos")) [[unlikely]] {
-          boost::erase_tail(result, 5);
-          result.push_back(U'\'');
-        } else if (result.ends_with(U"&amp")) [[unlikely]] {
-          boost::erase_tail(result, 4);
-          result.push_back(U'&');
+        else if (ends_with(begin, out, "&lt")) [[unlikely]] {
+          erase_tail(3);
+          push_back(U'<');
+        } else if (ends_with(begin, out, "&gt")) [[unlikely]] {
+          erase_tail(3);
+          push_back(U'>');
+        } else if (ends_with(begin, out, "&quot")) [[unlikely]] {
+          erase_tail(5);
+          push_back(U'"');
+        } else if (ends_with(begin, out, "&apos")) [[unlikely]] {
+          erase_tail(5);
+          push_back(U'\'');
+        } else if (ends_with(begin, out, "&amp")) [[unlikely]] {
+          erase_tail(4);
+          push_back(U'&');
         } else [[likely]] {
-          result.push_back(U'；');
+          push_back(U'；');
         }
       } else if (code_point == U'(') {
-        result.push_back(U'（');
+        push_back(U'（');
       } else if (code_point == U')') {
-        result.push_back(U'）');
-      } else if (code_point == U'。') {
-        if (!std::empty(result) && result.back() == U'。') {
-          continue;
-        }
-        result.push_back(code_point);
-      } else if (code_point == U'，') {
-        if (!std::empty(result) && result.back() == U'，') {
-          continue;
-        }
-        result.push_back(code_point);
-      } else if (code_point == U'、') {
-        if (!std::empty(result) && result.back() == U'、') {
+        push_back(U'）');
+      } else if (code_point == U'。' || code_point == U'，' ||
+                 code_point == U'、') {
+        if (out != begin && back == code_point) {
           continue;
         }
-        result.push_back(code_point);
+        push_back(code_point);
       } else {
-        result.push_back(code_point);
+        push_back(code_point);
       }
     } else if (code_point == U'~') {
-      result.push_back(U'～');
+      push_back(U'～');
     } else {
-      char32_t c = code_point;
+      push_back(fold_table.fold(code_point, translation));
+    }
+  }
 
-      if (translation) {
-        static const phmap::flat_hash_map<char32_t, char32_t> map{
-            {U'幺', U'么'}};
-        if (auto iter = map.find(c); iter != std::end(map)) {
-          c = iter->second;
-        }
-      }
+  result.resize(static_cast<std::size_t>(out - begin));
+}
 
-      static const phmap::flat_hash_map<char32_t, char32_t> map{
-          {U'妳', U'你'},
-          {U'壊', U'坏'},
-          {U'拚', U'拼'},
-          {U'噁', U'恶'},
-          {U'歳', U'岁'},
-          {U'経', U'经'},
-          {U'験', U'验'},
-          {U'険', U'险'},
-          {U'撃', U'击'},
-          {U'錬', U'炼'},
-          {U'隷', U'隶'},
-          {U'毎', U'每'},
-          {U'捩', U'折'},
-          {U'殻', U'壳'},
-          {U'牠', U'它'},
-          {U'矇', U'蒙'},
-          {U'髮', U'发'},
-          {U'姊', U'姐'},
-          {U'黒', U'黑'},
-          {U'歴', U'历'},
-          {U'様', U'样'},
-          {U'甦', U'苏'},
-          {U'牴', U'抵'},
-          {U'銀', U'银'},
-          {U'齢', U'龄'},
-          {U'従', U'从'},
-          {U'酔', U'醉'},
-          {U'値', U'值'},
-          {U'発', U'发'},
-          {U'続', U'续'},
-          {U'転', U'转'},
-          {U'剣', U'剑'},
-          {U'砕', U'碎'},
-          {U'鉄', U'铁'},
-          {U'甯', U'宁'},
-          {U'鬪', U'斗'},
-          {U'寛', U'宽'},
-          {U'変', U'变'},
-          {U'鳮', U'鸡'},
-          {U'悪', U'恶'},
-          {U'霊', U'灵'},
-          {U'戦', U'战'},
-          {U'権', U'权'},
-          {U'効', U'效'},
-          {U'応', U'应'},
-          {U'覚', U'觉'},
-          {U'観', U'观'},
-          {U'気', U'气'},
-          {U'覧', U'览'},
-          {U'殭', U'僵'},
-          {U'郞', U'郎'},
-          {U'虊', U'药'},
-          {U'踼', U'踢'},
-          {U'逹', U'达'},
-          {U'鑜', U'锁'},
-          {U'髲', U'发'},
-          {U'髪', U'发'},
-          {U'実', U'实'},
-          {U'內', U'内'},
-          {U'穨', U'颓'},
-          {U'糸', U'系'},
-          {U'賍', U'赃'},
-          {U'掦', U'扬'},
-          {U'覇', U'霸'},
-          {U'姉', U'姐'},
-          {U'楽', U'乐'},
-          {U'継', U'继'},
-          {U'隠', U'隐'},
-          {U'巻', U'卷'},
-          {U'膞', U'膊'},
-          {U'髑', U'骷'},
-          {U'劄', U'札'},
-          {U'擡', U'抬'},
-          {U'⼈', U'人'},
-          {U'⾛', U'走'},
-          {U'⼤', U'大'},
-          {U'⽤', U'用'},
-          {U'⼿', U'手'},
-          {U'⼦', U'子'},
-          {U'⽽', U'而'},
-          {U'⾄', U'至'},
-          {U'⽯', U'石'},
-          {U'⼗', U'十'},
-          {U'⽩', U'白'},
-          {U'⽗', U'父'},
-          {U'⽰', U'示'},
-          {U'⾁', U'肉'},
-          {U'⼠', U'士'},
-          {U'⽌', U'止'},
-          {U'⼀', U'一'},
-          {U'⺠', U'民'},
-          {U'揹', U'背'},
-          {U'佈', U'布'},
-          {U'勐', U'猛'},
-          {U'嗳', U'哎'},
-          {U'纔', U'才'},
-          {U'繄', U'紧'},
-          {U'勧', U'劝'},
-          {U'鐡', U'铁'},
-          {U'犠', U'牺'},
-          {U'繊', U'纤'},
-          {U'郷', U'乡'},
-          {U'亊', U'事'},
-          {U'騒', U'骚'},
-          {U'聡', U'聪'},
-          {U'遅', U'迟'},
-          {U'唖', U'哑'},
-          {U'獣', U'兽'},
-          {U'読', U'读'},
-          {U'囙', U'因'},
-          {U'寘', U'置'},
-          {U'対', U'对'},
-          {U'処', U'处'},
-          {U'団', U'团'},
-          {U'祢', U'你'},
-          {U'閙', U'闹'},
-          {U'谘', U'咨'},
-          {U'摀', U'捂'},
-          {U'類', U'类'},
-          {U'諷', U'讽'},
-          {U'唿', U'呼'},
-          {U'噹', U'当'},
-          {U'沒', U'没'},
-          {U'別', U'别'},
-          {U'歿', U'殁'},
-          {U'羅', U'罗'},
-          {U'給', U'给'},
-          {U'頽', U'颓'},
-          {U'來', U'来'},
-          {U'裝', U'装'},
-          {U'燈', U'灯'},
-          {U'蓋', U'盖'},
-          {U'迴', U'回'},
-          {U'單', U'单'},
-          {U'勢', U'势'},
-          {U'結', U'结'},
-          {U'砲', U'炮'},
-          {U'採', U'采'},
-          {U'財', U'财'},
-          {U'頂', U'顶'},
-          {U'倆', U'俩'},
-          {U'祕', U'秘'},
-          // https://zh.wikipedia.org/wiki/%E5%85%A8%E5%BD%A2%E5%92%8C%E5%8D%8A%E5%BD%A2
-          {U'＂', U'"'},
-          {U'＃', U'#'},
-          {U'＄', U'$'},
-          {U'％', U'%'},
-          {U'＆', U'&'},
-          {U'＇', U'\''},
-          {U'＊', U'*'},
-          {U'＋', U'+'},
-          {U'．', U'.'},
-          {U'／', U'/'},
-          {U'０', U'0'},
-          {U'１', U'1'},
-          {U'２', U'2'},
-          {U'３', U'3'},
-          {U'４', U'4'},
-          {U'５', U'5'},
-          {U'６', U'6'},
-          {U'７', U'7'},
-          {U'８', U'8'},
-          {U'９', U'9'},
-          {U'＜', U'<'},
-          {U'＝', U'='},
-          {U'＞', U'>'},
-          {U'＠', U'@'},
-          {U'Ａ', U'A'},
-          {U'Ｂ', U'B'},
-          {U'Ｃ', U'C'},
-          {U'Ｄ', U'D'},
-          {U'Ｅ', U'E'},
-          {U'Ｆ', U'F'},
-          {U'Ｇ', U'G'},
-          {U'Ｈ', U'H'},
-          {U'Ｉ', U'I'},
-          {U'Ｊ', U'J'},
-          {U'Ｋ', U'K'},
-          {U'Ｌ', U'L'},
-          {U'Ｍ', U'M'},
-          {U'Ｎ', U'N'},
-          {U'Ｏ', U'O'},
-          {U'Ｐ', U'P'},
-          {U'Ｑ', U'Q'},
-          {U'Ｒ', U'R'},
-          {U'Ｓ', U'S'},
-          {U'Ｔ', U'T'},
-          {U'Ｕ', U'U'},
-          {U'Ｖ', U'V'},
-          {U'Ｗ', U'W'},
-          {U'Ｘ', U'X'},
-          {U'Ｙ', U'Y'},
-          {U'Ｚ', U'Z'},
-          {U'＼', U'\\'},
-          {U'＾', U'^'},
-          {U'｀', U'`'},
-          {U'ａ', U'a'},
-          {U'ｂ', U'b'},
-          {U'ｃ', U'c'},
-          {U'ｄ', U'd'},
-          {U'ｅ', U'e'},
-          {U'ｆ', U'f'},
-          {U'ｇ', U'g'},
-          {U'ｈ', U'h'},
-          {U'ｉ', U'i'},
-          {U'ｊ', U'j'},
-          {U'ｋ', U'k'},
-          {U'ｌ', U'l'},
-          {U'ｍ', U'm'},
-          {U'ｎ', U'n'},
-          {U'ｏ', U'o'},
-          {U'ｐ', U'p'},
-          {U'ｑ', U'q'},
-          {U'ｒ', U'r'},
-          {U'ｓ', U's'},
-          {U'ｔ', U't'},
-          {U'ｕ', U'u'},
-          {U'ｖ', U'v'},
-          {U'ｗ', U'w'},
-          {U'ｘ', U'x'},
-          {U'ｙ', U'y'},
-          {U'ｚ', U'z'},
-          {U'｛', U'{'},
-          {U'｜', U'|'},
-          {U'｝', U'}'},
-          {U'｡', U'。'},
-          {U'｢', U'「'},
-          {U'｣', U'」'},
-          {U'､', U'、'},
-          {U'･', U'·'},
-          {U'•', U'·'},
-          {U'─', U'—'},
-      };
-      if (auto iter = map.find(c); iter != std::end(map)) {
-        c = iter->second;
-      }
+void custom_trans(std::string_view str, bool translation,
+                  std::string &result) {
+  fold(str, translation, result);
+  get_replacer(translation).replace(result);
+}
 
-      result.push_back(c);
-    }
-  }
+// Lines translated with translation, and those that skipped the converter
+std::atomic<std::uint64_t> translated_lines = 0;
+std::atomic<std::uint64_t> skipped_lines = 0;
 
-  if (translation) {
-    boost::replace_all(result, U"颠复", U"颠覆");
+const Converter &get_converter() {
+  static const Converter converter;
+  return converter;
+}
+
+// Every line translated with translation goes through here exactly once, before
+// the cache, so this is the only place lines are counted
+bool may_convert(std::string_view str) {
+  const auto result = get_converter().may_convert(str);
+
+  translated_lines.fetch_add(1, std::memory_order_relaxed);
+  if (!result) {
+    skipped_lines.fetch_add(1, std::memory_order_relaxed);
   }
-  boost::replace_all(result, U"赤果果", U"赤裸裸");
-  boost::replace_all(result, U"赤果", U"赤裸");
-  boost::replace_all(result, U"廿", U"二十");
-  boost::replace_all(result, U"卅", U"三十");
 
   return result;
 }
 
-std::string do_trans_str(const std::u32string &str, bool translation) {
-  auto std_str = klib::utf32_to_utf8(custom_trans(str, translation));
-  klib::trim(std_str);
-  return std_str;
+void normalize(std::string_view str, bool translation, std::string &result) {
+  custom_trans(str, translation, result);
+  klib::trim(result);
 }
 
-}  // namespace
+std::string normalize(std::string_view str, bool translation) {
+  std::string result;
+  normalize(str, translation, result);
 
-std::string trans_str(const std::string &str, bool translation) {
-  std::string std_str(std::data(str), std::size(str));
-  if (translation) {
-    static const Converter converter;
-    std_str = converter.convert(std_str);
+  return result;
+}
+
+TransCache &get_cache() {
+  static TransCache cache;
+  return cache;
+}
+
+// Lines that may_convert() let through
+void convert(std::span<std::string *> lines) {
+  const auto &converter = get_converter();
+
+  if (std::size(lines) <= 1) {
+    for (auto *line : lines) {
+      *line = normalize(converter.convert(*line), true);
+    }
+    return;
   }
 
-  return do_trans_str(klib::utf8_to_utf32(std_str), translation);
+  // No dictionary entry contains '\n', so converting the joined lines is the
+  // same as converting them one by one
+  std::size_t size = 0;
+  for (const auto *line : lines) {
+    size += std::size(*line) + 1;
+  }
+  std::string joined;
+  joined.reserve(size);
+  for (const auto *line : lines) {
+    joined.append(*line).push_back('\n');
+  }
+
+  const auto converted = converter.convert(joined);
+  if (std::count(std::begin(converted), std::end(converted), '\n') !=
+      static_cast<std::ptrdiff_t>(std::size(lines))) [[unlikely]] {
+    // Some line contains '\n' itself
+    for (auto *line : lines) {
+      *line = normalize(converter.convert(*line), true);
+    }
+    return;
+  }
+
+  std::string_view rest = converted;
+  for (auto *line : lines) {
+    const auto pos = rest.find('\n');
+    *line = normalize(rest.substr(0, pos), true);
+    rest.remove_prefix(pos + 1);
+  }
+}
+
+}  // namespace
+
+std::string trans_str(const std::string &str, bool translation) {
+  return trans_str(std::string_view(str), translation);
 }
 
 std::string trans_str(std::string_view str, bool translation) {
-  return trans_str(std::string(std::data(str), std::size(str)), translation);
+  // A cache lookup costs about as much as custom_trans(), so only lines that
+  // go through the converter are cached
+  if (!translation || !may_convert(str)) {
+    return normalize(str, translation);
+  }
+
+  auto &cache = get_cache();
+  if (auto result = cache.get(str, translation); result) {
+    return std::move(*result);
+  }
+
+  std::string result(str);
+  std::string *line = &result;
+  convert(std::span(&line, 1));
+  cache.put(str, translation, result);
+
+  return result;
 }
 
 std::string trans_str(const char *str, bool translation) {
   return trans_str(std::string_view(str), translation);
 }
 
+void trans_lines(std::span<std::string> lines, bool translation) {
+  if (!translation) {
+    for (auto &line : lines) {
+      line = normalize(line, translation);
+    }
+    return;
+  }
+
+  auto &cache = get_cache();
+
+  std::vector<std::string *> misses;
+  std::vector<std::string> inputs;
+  for (auto &line : lines) {
+    if (!may_convert(line)) {
+      line = normalize(line, translation);
+    } else if (auto result = cache.get(line, translation); result) {
+      line = std::move(*result);
+    } else {
+      misses.push_back(&line);
+      inputs.push_back(line);
+    }
+  }
+
+  convert(misses);
+
+  for (std::size_t i = 0; i < std::size(misses); ++i) {
+    cache.put(inputs[i], translation, *misses[i]);
+  }
+}
+
+void trans_lines(std::span<const std::string_view> lines,
+                 std::span<std::optional<std::string>> changed,
+                 bool translation) {
+  thread_local std::string buffer;
+  auto &cache = get_cache();
+
+  std::vector<std::size_t> misses;
+  std::vector<std::string *> results;
+  for (std::size_t i = 0; i < std::size(lines); ++i) {
+    const auto line = lines[i];
+    auto &result = changed[i];
+    result.reset();
+
+    if (!translation || !may_convert(line)) {
+      normalize(line, translation, buffer);
+      if (buffer != line) {
+        result = buffer;
+      }
+    } else if (auto cached = cache.get(line, translation); cached) {
+      if (*cached != line) {
+        result = std::move(*cached);
+      }
+    } else {
+      misses.push_back(i);
+      results.push_back(&result.emplace(line));
+    }
+  }
+
+  convert(results);
+
+  for (auto i : misses) {
+    cache.put(lines[i], translation, *changed[i]);
+    if (*changed[i] == lines[i]) {
+      changed[i].reset();
+    }
+  }
+}
+
+TransStats trans_stats() {
+  const auto &cache = get_cache();
+  return {translated_lines.load(std::memory_order_relaxed),
+          skipped_lines.load(std::memory_order_relaxed), cache.hits(),
+          cache.misses()};
+}
+
+void log_trans_stats() {
+  if (const auto stats = trans_stats(); stats.lines_ != 0) {
+    klib::info("Lines without Traditional Chinese: {}/{}", stats.skipped_,
+               stats.lines_);
+  }
+}
+
+void trans_chapter(Chapter &chapter, bool translation) {
+  std::vector<std::string> lines;
+  lines.reserve(std::size(chapter.texts_) + 1);
+  lines.push_back(std::move(chapter.title_));
+  std::move(std::begin(chapter.texts_), std::end(chapter.texts_),
+            std::back_inserter(lines));
+
+  trans_lines(lines, translation);
+
+  chapter.title_ = std::move(lines.front());
+  chapter.texts_.clear();
+  for (auto iter = std::begin(lines) + 1; iter != std::end(lines); ++iter) {
+    push_back(chapter.texts_, *iter);
+  }
+}
+
+void load_replace_dict(const std::string &file_name) {
+  check_file_exist(file_name);
+
+  const auto dict = klib::read_file(file_name, false);
+  std::vector<std::pair<std::string, std::string>> replacements;
+  std::string key;
+
+  std::size_t line_num = 0;
+  for (std::string_view rest = dict; !std::empty(rest);) {
+    const auto end = std::min(rest.find('\n'), std::size(rest));
+    auto line = rest.substr(0, end);
+    rest.remove_prefix(std::min(end + 1, std::size(rest)));
+    ++line_num;
+
+    if (line.ends_with('\r')) {
+      line.remove_suffix(1);
+    }
+    if (std::empty(line) || line.starts_with('#')) {
+      continue;
+    }
+
+    const auto tab = line.find('\t');
+    if (tab == std::string_view::npos) {
+      klib::warn("No tab in line {} of '{}', ignored: {}", line_num, file_name,
+                 line);
+      continue;
+    }
+
+    const auto from = line.substr(0, tab);
+    fold(from, false, key);
+    if (std::empty(key)) {
+      klib::warn("Empty string to be replaced in line {} of '{}', ignored",
+                 line_num, file_name);
+      continue;
+    }
+
+    replacements.emplace_back(from, line.substr(tab + 1));
+  }
+  klib::info("Load {} replacements from '{}'", std::size(replacements),
+             file_name);
+
+  user_replacements() = std::move(replacements);
+  get_cache().clear();
+  get_replacer(false) = make_replacer(false);
+  get_replacer(true) = make_replacer(true);
+}
+
 }  // namespace kepub
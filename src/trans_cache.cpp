@@ -0,0 +1,80 @@
+#include "trans_cache.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace kepub {
+
+TransCache::TransCache(std::size_t capacity)
+    : shard_capacity_(std::max<std::size_t>(capacity / shard_count, 1)) {}
+
+std::optional<std::string> TransCache::get(std::string_view str,
+                                           bool translation) {
+  if (std::size(str) > max_str_size) {
+    return {};
+  }
+
+  const auto key = hash(str, translation);
+  auto &item = shard(key);
+
+  std::lock_guard lock(item.mutex_);
+  if (auto iter = item.map_.find(key);
+      iter != std::end(item.map_) && iter->second.str_ == str &&
+      iter->second.translation_ == translation) {
+    ++item.hits_;
+    return iter->second.result_;
+  }
+
+  ++item.misses_;
+  return {};
+}
+
+void TransCache::put(std::string_view str, bool translation,
+                     const std::string &result) {
+  if (std::size(str) > max_str_size) {
+    return;
+  }
+
+  const auto key = hash(str, translation);
+  auto &item = shard(key);
+
+  std::lock_guard lock(item.mutex_);
+  if (std::size(item.map_) >= shard_capacity_) {
+    item.map_.clear();
+  }
+  item.map_.insert_or_assign(key, Entry{std::string(str), translation, result});
+}
+
+void TransCache::clear() {
+  for (auto &item : shards_) {
+    std::lock_guard lock(item.mutex_);
+    item.map_.clear();
+  }
+}
+
+std::uint64_t TransCache::hits() const {
+  std::uint64_t result = 0;
+  for (const auto &item : shards_) {
+    std::lock_guard lock(item.mutex_);
+    result += item.hits_;
+  }
+
+  return result;
+}
+
+std::uint64_t TransCache::misses() const {
+  std::uint64_t result = 0;
+  for (const auto &item : shards_) {
+    std::lock_guard lock(item.mutex_);
+    result += item.misses_;
+  }
+
+  return result;
+}
+
+std::uint64_t TransCache::hash(std::string_view str, bool translation) {
+  const std::uint64_t result = std::hash<std::string_view>{}(str);
+  return translation ? result ^ 0x9E3779B97F4A7C15 : result;
+}
+
+}  // namespace kepub
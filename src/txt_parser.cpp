@@ -0,0 +1,203 @@
+#include "txt_parser.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <utility>
+
+#include <klib/log.h>
+#include <oneapi/tbb.h>
+#include <simdjson.h>
+
+#include "encoding.h"
+#include "trans.h"
+
+namespace kepub {
+
+namespace {
+
+constexpr std::string_view author_prefix = "[AUTHOR]";
+constexpr std::string_view introduction_prefix = "[INTRO]";
+constexpr std::string_view postscript_prefix = "[POST]";
+constexpr std::string_view volume_prefix = "[VOLUME] ";
+constexpr std::string_view title_prefix = "[WEB] ";
+
+// Translate this many lines in each task
+constexpr std::size_t block_size = 1024;
+
+}  // namespace
+
+TxtParser::TxtParser(TxtHandler handler, bool translation)
+    : handler_(std::move(handler)), translation_(translation) {}
+
+void TxtParser::feed(std::string_view data) {
+  const auto pos = data.rfind('\n');
+  if (pos == std::string_view::npos) {
+    buffer_.append(data);
+    return;
+  }
+
+  // The lines view data or buffer_, so they are parsed before either changes
+  if (std::empty(buffer_)) {
+    split_lines(data.substr(0, pos + 1));
+  } else {
+    buffer_.append(data.substr(0, pos + 1));
+    split_lines(buffer_);
+  }
+  flush();
+
+  buffer_.assign(data.substr(pos + 1));
+}
+
+void TxtParser::finish() {
+  if (!std::empty(buffer_)) {
+    // The same as std::getline(), the last line does not need a '\n'
+    buffer_.push_back('\n');
+    split_lines(buffer_);
+    flush();
+    buffer_.clear();
+  }
+
+  end_section();
+}
+
+void TxtParser::parse_file(const std::string &file_name) {
+  std::ifstream ifs(file_name, std::ifstream::binary);
+  if (!ifs) {
+    klib::error("Failed to open file: '{}'", file_name);
+  }
+
+  std::string chunk(1024 * 1024, '\0');
+  std::optional<Transcoder> transcoder;
+  std::string utf8;
+  // Bytes of an incomplete character kept at the front of chunk
+  std::size_t kept = 0;
+
+  for (bool first = true; ifs; first = false) {
+    ifs.read(std::data(chunk) + kept,
+             static_cast<std::streamsize>(std::size(chunk) - kept));
+    const std::string_view data(
+        std::data(chunk), kept + static_cast<std::size_t>(ifs.gcount()));
+
+    if (first) {
+      if (const auto encoding = detect_encoding(data);
+          encoding != Encoding::Utf8) {
+        klib::info("Convert '{}' from {} to UTF-8", file_name,
+                   encoding_name(encoding));
+        transcoder.emplace(encoding);
+      }
+    }
+
+    if (!transcoder) {
+      feed(data);
+      continue;
+    }
+
+    utf8.clear();
+    const auto size = transcoder->transcode(data, utf8);
+    feed(utf8);
+
+    kept = std::size(data) - size;
+    std::memmove(std::data(chunk), std::data(chunk) + size, kept);
+  }
+
+  if (kept != 0) {
+    klib::error("Incomplete character at the end of '{}'", file_name);
+  }
+
+  finish();
+}
+
+// data ends with '\n', so a code point never crosses it
+void TxtParser::split_lines(std::string_view data) {
+  const auto valid = simdjson::validate_utf8(std::data(data), std::size(data));
+
+  const auto *ptr = std::data(data);
+  const auto *const last = ptr + std::size(data);
+  while (ptr != last) {
+    const auto *newline = static_cast<const char *>(
+        std::memchr(ptr, '\n', static_cast<std::size_t>(last - ptr)));
+    const std::string_view line(ptr, static_cast<std::size_t>(newline - ptr));
+
+    if (!valid && !simdjson::validate_utf8(std::data(line), std::size(line))) {
+      klib::error("Invalid UTF-8: {}", line);
+    }
+
+    lines_.push_back(line);
+    ptr = newline + 1;
+  }
+}
+
+void TxtParser::flush() {
+  changed_.resize(std::size(lines_));
+
+  const auto block_count = (std::size(lines_) + block_size - 1) / block_size;
+  oneapi::tbb::parallel_for(std::size_t(0), block_count, [&](std::size_t i) {
+    const auto first = i * block_size;
+    const auto count = std::min(block_size, std::size(lines_) - first);
+
+    trans_lines(std::span<const std::string_view>(lines_).subspan(first, count),
+                std::span(changed_).subspan(first, count), translation_);
+  });
+
+  for (std::size_t i = 0; i < std::size(lines_); ++i) {
+    const std::string_view line =
+        changed_[i] ? std::string_view(*changed_[i]) : lines_[i];
+    if (!std::empty(line)) {
+      parse_line(line, changed_[i]);
+    }
+  }
+  lines_.clear();
+}
+
+// line views changed if the translation changed it, which can be moved from
+void TxtParser::parse_line(std::string_view line,
+                           std::optional<std::string> &changed) {
+  const auto take = [&] {
+    return changed ? std::move(*changed) : std::string(line);
+  };
+
+  if (state_ == State::Author) {
+    handler_.author_(take());
+    state_ = State::None;
+    return;
+  }
+
+  if (handler_.author_ && line.starts_with(author_prefix)) {
+    end_section();
+    state_ = State::Author;
+  } else if (handler_.introduction_ && line.starts_with(introduction_prefix)) {
+    end_section();
+    state_ = State::Introduction;
+  } else if (handler_.postscript_ && line.starts_with(postscript_prefix)) {
+    end_section();
+    state_ = State::Postscript;
+  } else if (handler_.volume_ && line.starts_with(volume_prefix)) {
+    end_section();
+    handler_.volume_(std::string(line.substr(std::size(volume_prefix))));
+  } else if (handler_.chapter_ && line.starts_with(title_prefix)) {
+    end_section();
+    state_ = State::Chapter;
+    title_ = line.substr(std::size(title_prefix));
+  } else if (state_ == State::Introduction) {
+    handler_.introduction_(take());
+  } else if (state_ == State::Postscript) {
+    handler_.postscript_(take());
+  } else if (state_ == State::Chapter) {
+    texts_.push_back(take());
+  }
+}
+
+void TxtParser::end_section() {
+  if (state_ == State::Chapter) {
+    handler_.chapter_(std::move(title_), std::move(texts_));
+    title_.clear();
+    texts_.clear();
+  }
+
+  state_ = State::None;
+}
+
+}  // namespace kepub
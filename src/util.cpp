@@ -1,14 +1,24 @@
 #include "util.h"
 
+#include <fcntl.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <array>
 #include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <exception>
 #include <filesystem>
-#include <fstream>
 #include <iostream>
-#include <sstream>
-
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string_view>
+#include <utility>
+
+#include <fmt/format.h>
 #include <klib/log.h>
 #include <klib/mime.h>
 #include <klib/qr_code.h>
@@ -17,29 +27,172 @@
 #include <klib/util.h>
 #include <oneapi/tbb.h>
 #include <parallel_hashmap/phmap.h>
-#include <re2/re2.h>
 #include <gsl/assert>
 
-#include "trans.h"
+#include "char_class.h"
 
 namespace kepub {
 
 namespace {
 
-bool start_with_chinese(const std::string &str) {
-  return klib::is_cjk(klib::first_code_point(str));
+enum class Join { Append, AppendWithSpace, NewParagraph };
+
+thread_local WarningBuffer *warning_buffer = nullptr;
+
+using CharSet =
+    phmap::parallel_flat_hash_set<char32_t,
+                                  phmap::priv::hash_default_hash<char32_t>,
+                                  phmap::priv::hash_default_eq<char32_t>,
+                                  std::allocator<char32_t>, 4, std::mutex>;
+
+// The unknown characters already reported, str_check() can be called by many
+// threads
+CharSet &reported() {
+  static CharSet set;
+  return set;
+}
+
+// The line, prefixed with where it is if known
+std::string where(std::string_view location, std::string_view line) {
+  if (std::empty(location)) {
+    return std::string(line);
+  }
+  return fmt::format("{}: {}", location, line);
+}
+
+// Like mkstemp(), but the permissions follow the umask, as with std::ofstream
+int open_temp_file(const std::string &file_name, std::string &temp_name) {
+  std::random_device device;
+  while (true) {
+    temp_name = fmt::format("{}.{:08x}.tmp", file_name, device());
+    const auto fd =
+        ::open(temp_name.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if (fd != -1 || errno != EEXIST) {
+      return fd;
+    }
+  }
+}
+
+std::string code_point_to_utf8(char32_t code_point) {
+  return klib::utf32_to_utf8(std::u32string(1, code_point));
+}
+
+template <typename... Args>
+void warn(fmt::format_string<Args...> fmt, Args &&...args) {
+  auto message = fmt::format(fmt, std::forward<Args>(args)...);
+
+  if (warning_buffer != nullptr) {
+    warning_buffer->add(std::move(message));
+  } else {
+    klib::warn("{}", message);
+  }
 }
 
-bool end_with_chinese(const std::string &str) {
-  return klib::is_cjk(klib::last_code_point(str));
+// How push_back() joins str to paragraph, whose last code point is last
+Join join(std::string_view paragraph, char32_t last, std::string_view str,
+          bool connect, bool check) {
+  using enum CharTable::Flag;
+
+  const auto &table = CharTable::get();
+  const auto prev = table.flags(last);
+  const auto next = table.flags(first_code_point(str));
+
+  if (prev & Comma) {
+    if (next & (Cjk | AsciiAlnum | Opening)) {
+      return Join::Append;
+    }
+
+    if (check) {
+      warn("Punctuation may be wrong: {}, previous row: {}", str, paragraph);
+    }
+    return Join::NewParagraph;
+  }
+
+  if (next & Closing) {
+    if (!(prev & Punctuation)) {
+      return Join::Append;
+    }
+
+    if (check && !(next & Exclamation)) {
+      warn("Punctuation may be wrong: {}", str);
+    }
+    return Join::NewParagraph;
+  }
+
+  if (connect && (prev & (AsciiAlpha | Cjk)) && (next & (AsciiAlpha | Cjk))) {
+    return (prev & Cjk) && (next & Cjk) ? Join::Append : Join::AppendWithSpace;
+  }
+
+  return Join::NewParagraph;
 }
 
-bool is_punctuation(char32_t code_point) {
-  return code_point == U'◇' || klib::is_chinese_punctuation(code_point);
+// Call func(code_point) for every character that str_check() reports
+template <typename Func>
+void for_each_unknown(std::string_view str, Func func) {
+  std::array<UnknownChar, 16> unknown;
+
+  while (true) {
+    const auto count = classify(str, unknown).unknown_;
+    for (std::size_t i = 0; i < std::min(count, std::size(unknown)); ++i) {
+      func(unknown[i].code_point_);
+    }
+
+    if (count <= std::size(unknown)) {
+      break;
+    }
+
+    // Continue after the last one written
+    auto pos = unknown.back().offset_;
+    [[maybe_unused]] const auto c = next_code_point(str, pos);
+    str = str.substr(pos);
+  }
 }
 
-bool end_with_punctuation(const std::string &str) {
-  return klib::is_chinese_punctuation(klib::last_code_point(str));
+// 第, 1 to max_count_ numerals, one of suffixes_, a space, then at least one
+// character and no '\n'. The same as the regex
+// 第([numerals_]|[0-9]){1,max_count_}[suffixes_] .+
+struct NameFormat {
+  std::u32string_view numerals_;
+  std::size_t max_count_;
+  std::u32string_view suffixes_;
+};
+
+constexpr NameFormat volume_name_format = {U"一二三四五六七八九十", 3, U"卷"};
+constexpr NameFormat title_format = {U"零一二三四五六七八九十百千", 7,
+                                     U"章话"};
+
+bool matches(std::string_view str, const NameFormat &format) {
+  constexpr std::string_view prefix = "第";
+  if (!str.starts_with(prefix)) {
+    return false;
+  }
+
+  auto pos = std::size(prefix);
+  std::size_t count = 0;
+  while (pos < std::size(str)) {
+    auto next = pos;
+    const auto c = next_code_point(str, next);
+    if (!((c >= U'0' && c <= U'9') ||
+          format.numerals_.find(c) != std::u32string_view::npos)) {
+      break;
+    }
+
+    pos = next;
+    ++count;
+  }
+
+  if (count == 0 || count > format.max_count_ || pos == std::size(str) ||
+      format.suffixes_.find(next_code_point(str, pos)) ==
+          std::u32string_view::npos) {
+    return false;
+  }
+
+  if (pos == std::size(str) || str[pos] != ' ') {
+    return false;
+  }
+
+  const auto rest = str.substr(pos + 1);
+  return !std::empty(rest) && rest.find('\n') == std::string_view::npos;
 }
 
 }  // namespace
@@ -104,71 +257,128 @@ void check_is_book_id(const std::string &book_id) {
   }
 }
 
-std::vector<std::string> read_file_to_vec(const std::string &file_name,
-                                          bool translation) {
-  std::ifstream ifs(file_name);
-  if (!ifs) {
-    klib::error("Failed to open file: '{}'", file_name);
+std::string location(std::size_t volume_index,
+                     std::optional<std::size_t> chapter_index,
+                     std::string_view title) {
+  auto result = fmt::format("volume {}", volume_index + 1);
+  if (chapter_index) {
+    result.append(fmt::format(", chapter {}", *chapter_index + 1));
+  }
+  if (!std::empty(title)) {
+    result.append(fmt::format(" '{}'", title));
   }
 
-  std::vector<std::string> result;
-  result.reserve(16384);
+  return result;
+}
+
+void Diagnostics::add_unknown(char32_t code_point, std::string_view line,
+                              std::uint64_t count, std::string_view location) {
+  items_.lazy_emplace_l(
+      code_point, [&](auto &item) { item.second.count_ += count; },
+      [&](const auto &ctor) {
+        ctor(code_point, Item{count, std::string(line), std::string(location),
+                              next_order_++});
+      });
+}
 
-  std::string line;
-  while (std::getline(ifs, line)) {
-    result.push_back(line);
+std::vector<UnknownCharacter> Diagnostics::unknown_characters() const {
+  std::vector<std::pair<std::uint64_t, UnknownCharacter>> items;
+  for (const auto &[code_point, item] : items_) {
+    items.push_back(
+        {item.order_, {code_point, item.count_, item.line_, item.location_}});
+  }
+  std::sort(std::begin(items), std::end(items),
+            [](const auto &lhs, const auto &rhs) {
+              return lhs.first < rhs.first;
+            });
+
+  std::vector<UnknownCharacter> result;
+  result.reserve(std::size(items));
+  for (auto &[_, item] : items) {
+    result.push_back(std::move(item));
   }
 
-  oneapi::tbb::parallel_for_each(result, [&](std::string &str) {
-    str = trans_str(str, translation);
-    if (!klib::validate_utf8(str)) {
-      klib::error("Invalid UTF-8: {}", str);
-    }
-  });
+  return result;
+}
+
+void Diagnostics::report() const {
+  const auto unknown_characters = this->unknown_characters();
+  if (std::empty(unknown_characters)) {
+    return;
+  }
 
-  std::erase_if(result,
-                [](const std::string &line) { return std::empty(line); });
+  std::string message =
+      fmt::format("Unknown characters: {}", std::size(unknown_characters));
+  for (const auto &item : unknown_characters) {
+    message.append(fmt::format("\n  {} (U+{:04X}) x{}, first in {}",
+                               code_point_to_utf8(item.code_point_),
+                               static_cast<std::uint32_t>(item.code_point_),
+                               item.count_,
+                               where(item.location_, item.line_)));
+  }
 
-  return result;
+  klib::warn("{}", message);
 }
 
-void str_check(const std::string &str) {
-  static phmap::flat_hash_set<char32_t> set;
+WarningBuffer::Scope::Scope(WarningBuffer &buffer)
+    : prev_(std::exchange(warning_buffer, &buffer)) {}
 
-  auto copy = str;
-  std::erase_if(copy, [](char c) { return std::isalnum(c) || c == ' '; });
+WarningBuffer::Scope::~Scope() { warning_buffer = prev_; }
 
-  for (auto c : klib::utf8_to_utf32(copy)) {
-    if (!klib::is_cjk(c) && !is_punctuation(c)) {
-      if (set.contains(c)) {
-        continue;
-      }
+void WarningBuffer::add(std::string message) {
+  warnings_.push_back({std::move(message)});
+}
 
-      set.insert(c);
+void WarningBuffer::add_unknown(char32_t code_point, const std::string &line) {
+  const auto [iter, inserted] =
+      unknown_.try_emplace(code_point, std::size(warnings_));
+  if (inserted) {
+    warnings_.push_back({line, code_point});
+  }
+  ++warnings_[iter->second].count_;
+}
 
+void WarningBuffer::flush(Diagnostics *diagnostics) {
+  for (const auto &warning : warnings_) {
+    if (warning.code_point_ == 0) {
+      klib::warn("{}", warning.message_);
+    } else if (diagnostics != nullptr) {
+      diagnostics->add_unknown(warning.code_point_, warning.message_,
+                               warning.count_, location_);
+    } else if (reported().insert(warning.code_point_).second) {
       klib::warn("Unknown character: {} in {}",
-                 klib::utf32_to_utf8(std::u32string(&c, 1)), str);
+                 code_point_to_utf8(warning.code_point_),
+                 where(location_, warning.message_));
     }
   }
-}
 
-std::int32_t str_size(const std::string &str) {
-  std::int32_t count = 0;
+  warnings_.clear();
+  unknown_.clear();
+}
 
-  for (auto c : klib::utf8_to_utf32(str)) {
-    if (klib::is_cjk(c)) {
-      ++count;
+void str_check(const std::string &str) {
+  for_each_unknown(str, [&](char32_t c) {
+    if (warning_buffer != nullptr) {
+      warning_buffer->add_unknown(c, str);
+    } else if (reported().insert(c).second) {
+      klib::warn("Unknown character: {} in {}", code_point_to_utf8(c), str);
     }
-  }
+  });
+}
+
+std::int32_t str_size(const std::string &str) { return count_cjk(str); }
 
-  return count;
+bool is_regular_volume_name(std::string_view str) {
+  return matches(str, volume_name_format);
 }
 
-void volume_name_check(const std::string &volume_name) {
-  static re2::RE2 regex = R"(第([一二三四五六七八九十]|[0-9]){1,3}卷 .+)";
+bool is_regular_title(std::string_view str) {
+  return matches(str, title_format);
+}
 
-  if (!re2::RE2::FullMatch(volume_name, regex)) {
-    klib::warn("Irregular volume name format: {}", volume_name);
+void volume_name_check(const std::string &volume_name) {
+  if (!is_regular_volume_name(volume_name)) {
+    warn("Irregular volume name format: {}", volume_name);
     return;
   }
 
@@ -176,17 +386,96 @@ void volume_name_check(const std::string &volume_name) {
 }
 
 void title_check(const std::string &title) {
-  static re2::RE2 regex =
-      R"(第([零一二三四五六七八九十百千]|[0-9]){1,7}[章话] .+)";
-
-  if (!re2::RE2::FullMatch(title, regex)) {
-    klib::warn("Irregular title format: {}", title);
+  if (!is_regular_title(title)) {
+    warn("Irregular title format: {}", title);
     return;
   }
 
   str_check(title);
 }
 
+std::vector<TitleIssue> check_titles(const Novel &novel) {
+  struct Item {
+    std::size_t volume_index_;
+    std::optional<std::size_t> chapter_index_;
+    std::vector<TitleIssue> issues_;
+  };
+
+  std::vector<Item> items;
+  for (std::size_t i = 0; i < std::size(novel.volumes_); ++i) {
+    if (!std::empty(novel.volumes_[i].title_)) {
+      items.push_back({i, {}, {}});
+    }
+    for (std::size_t j = 0; j < std::size(novel.volumes_[i].chapters_); ++j) {
+      items.push_back({i, j, {}});
+    }
+  }
+
+  oneapi::tbb::parallel_for(
+      std::size_t(0), std::size(items), [&](std::size_t i) {
+        auto &item = items[i];
+        const auto &volume = novel.volumes_[item.volume_index_];
+
+        const auto is_title = item.chapter_index_.has_value();
+        const auto &text = is_title
+                               ? volume.chapters_[*item.chapter_index_].title_
+                               : volume.title_;
+
+        auto add = [&](TitleIssue::Kind kind, char32_t code_point) {
+          item.issues_.push_back({kind, item.volume_index_,
+                                  item.chapter_index_, text, code_point});
+        };
+
+        if (is_title ? !is_regular_title(text)
+                     : !is_regular_volume_name(text)) {
+          add(is_title ? TitleIssue::Kind::IrregularTitle
+                       : TitleIssue::Kind::IrregularVolumeName,
+              0);
+          return;
+        }
+
+        phmap::flat_hash_set<char32_t> unknown;
+        for_each_unknown(text, [&](char32_t c) {
+          if (unknown.insert(c).second) {
+            add(TitleIssue::Kind::UnknownCharacter, c);
+          }
+        });
+      });
+
+  std::vector<TitleIssue> result;
+  for (auto &item : items) {
+    std::move(std::begin(item.issues_), std::end(item.issues_),
+              std::back_inserter(result));
+  }
+
+  return result;
+}
+
+void report_title_issues(const std::vector<TitleIssue> &issues,
+                         Diagnostics *diagnostics) {
+  for (const auto &issue : issues) {
+    switch (issue.kind_) {
+      case TitleIssue::Kind::IrregularVolumeName:
+        klib::warn("Irregular volume name format: {}", issue.text_);
+        break;
+      case TitleIssue::Kind::IrregularTitle:
+        klib::warn("Irregular title format: {}", issue.text_);
+        break;
+      case TitleIssue::Kind::UnknownCharacter:
+        if (const auto place =
+                location(issue.volume_index_, issue.chapter_index_);
+            diagnostics != nullptr) {
+          diagnostics->add_unknown(issue.code_point_, issue.text_, 1, place);
+        } else if (reported().insert(issue.code_point_).second) {
+          klib::warn("Unknown character: {} in {}",
+                     code_point_to_utf8(issue.code_point_),
+                     where(place, issue.text_));
+        }
+        break;
+    }
+  }
+}
+
 void push_back(std::vector<std::string> &texts, const std::string &str,
                bool connect, bool check) {
   if (std::empty(str)) {
@@ -198,50 +487,17 @@ void push_back(std::vector<std::string> &texts, const std::string &str,
     return;
   }
 
-  if (texts.back().ends_with("，")) {
-    if ((start_with_chinese(str) || std::isalnum(str.front())) ||
-        (str.starts_with("—") || str.starts_with("“") ||
-         str.starts_with("「") || str.starts_with("『") ||
-         str.starts_with("《") || str.starts_with("[") ||
-         str.starts_with("【") || str.starts_with("（"))) {
-      texts.back().append(str);
-    } else {
-      if (check) {
-        klib::warn("Punctuation may be wrong: {}, previous row: {}", str,
-                   texts.back());
-      }
-      texts.push_back(str);
-    }
-  } else if (str.starts_with("！") || str.starts_with("？") ||
-             str.starts_with("，") || str.starts_with("。") ||
-             str.starts_with("、") || str.starts_with("”") ||
-             str.starts_with("」") || str.starts_with("』") ||
-             str.starts_with("》") || str.starts_with("]") ||
-             str.starts_with("】") || str.starts_with("）")) {
-    if (!end_with_punctuation(texts.back())) {
+  switch (join(texts.back(), last_code_point(texts.back()), str, connect,
+               check)) {
+    case Join::Append:
       texts.back().append(str);
-    } else {
-      if (check) {
-        if (!(str.starts_with("！") || str.starts_with("？"))) {
-          klib::warn("Punctuation may be wrong: {}", str);
-        }
-      }
+      break;
+    case Join::AppendWithSpace:
+      texts.back().append(" ").append(str);
+      break;
+    case Join::NewParagraph:
       texts.push_back(str);
-    }
-  } else if (connect && std::isalpha(texts.back().back()) &&
-             std::isalpha(str.front())) {
-    texts.back().append(" " + str);
-  } else if (connect && end_with_chinese(texts.back()) &&
-             std::isalpha(str.front())) {
-    texts.back().append(" " + str);
-  } else if (connect && std::isalpha(texts.back().back()) &&
-             start_with_chinese(str)) {
-    texts.back().append(" " + str);
-  } else if (connect && end_with_chinese(texts.back()) &&
-             start_with_chinese(str)) {
-    texts.back().append(str);
-  } else {
-    texts.push_back(str);
+      break;
   }
 }
 
@@ -251,6 +507,46 @@ void push_back(std::vector<std::string> &texts, const std::string &str) {
   }
 }
 
+ParagraphAssembler::ParagraphAssembler(bool connect, bool check)
+    : connect_(connect), check_(check) {}
+
+void ParagraphAssembler::add(std::string_view line) {
+  if (std::empty(line)) {
+    return;
+  }
+
+  auto action = Join::NewParagraph;
+  if (!std::empty(starts_)) {
+    action = join(std::string_view(buffer_).substr(starts_.back()), last_,
+                  line, connect_, check_);
+  }
+
+  if (action == Join::AppendWithSpace) {
+    buffer_.push_back(' ');
+  } else if (action == Join::NewParagraph) {
+    starts_.push_back(std::size(buffer_));
+  }
+  buffer_.append(line);
+  last_ = last_code_point(line);
+}
+
+std::vector<std::string> ParagraphAssembler::take() {
+  std::vector<std::string> result;
+  result.reserve(std::size(starts_));
+
+  for (std::size_t i = 0; i < std::size(starts_); ++i) {
+    const auto end =
+        i + 1 < std::size(starts_) ? starts_[i + 1] : std::size(buffer_);
+    result.emplace_back(buffer_, starts_[i], end - starts_[i]);
+  }
+
+  buffer_.clear();
+  starts_.clear();
+  last_ = 0;
+
+  return result;
+}
+
 std::string get_login_name() {
   std::string login_name;
 
@@ -333,81 +629,169 @@ std::string make_book_name_legal(const std::string &file_name) {
   return new_file_name;
 }
 
-void generate_txt(const BookInfo &book_info,
-                  const std::vector<Volume> &volumes) {
-  std::ostringstream oss;
+TxtWriter::TxtWriter(std::string file_name)
+    : file_name_(std::move(file_name)),
+      fd_(open_temp_file(file_name_, temp_name_)),
+      uncaught_exceptions_(std::uncaught_exceptions()) {
+  if (fd_ == -1) {
+    klib::error("Failed to open file: '{}'", temp_name_);
+  }
+  buffer_.reserve(buffer_size);
+}
+
+TxtWriter::~TxtWriter() {
+  if (fd_ == -1) {
+    return;
+  }
 
-  oss << book_info.name_ << "\n";
-  oss << "作者：" << book_info.author_ << "\n";
-  oss << "来源：" << book_info.source_ << "\n";
-  oss << "简介：" << "\n";
+  if (std::uncaught_exceptions() == uncaught_exceptions_) {
+    close();
+  } else {
+    ::close(fd_);
+    ::unlink(temp_name_.c_str());
+  }
+}
+
+void TxtWriter::write_book_info(const BookInfo &book_info) {
+  indent_ = book_info.source_ == "菠萝包";
+
+  append(book_info.name_);
+  append("\n作者：");
+  append(book_info.author_);
+  append("\n来源：");
+  append(book_info.source_);
+  append("\n简介：\n");
   for (const auto &line : book_info.introduction_) {
-    oss << line << "\n";
+    append(line);
+    append("\n");
+  }
+  append("\n\n\n\n\n");
+}
+
+void TxtWriter::write_chapter(const std::string &volume_title,
+                              const Chapter &chapter) {
+  if (!std::empty(volume_title)) {
+    append(volume_title);
+    append(" : ");
   }
-  oss << "\n\n\n\n\n";
+  append(chapter.title_);
+  append("\n\n");
 
-  // old_name new_name
-  phmap::flat_hash_map<std::string, std::string> image_name_map;
-  for (const auto &volume : volumes) {
-    if (std::empty(volume.chapters_)) {
-      continue;
+  for (const auto &line : chapter.texts_) {
+    if (indent_) {
+      append("　　");
     }
+    append(line);
+    append("\n");
+  }
+  append("\n\n\n");
+}
 
-    for (const auto &chapter : volume.chapters_) {
-      if (!std::empty(volume.title_)) {
-        oss << volume.title_ << " : " << chapter.title_ << "\n\n";
-      }
-      else{
-        oss << chapter.title_ << "\n\n";
-      }
+void TxtWriter::close() {
+  if (fd_ == -1) {
+    return;
+  }
 
-      for (const auto &line : chapter.texts_) { 
-        if (book_info.source_ == "菠萝包"){
-          oss << "　　";
-        }
-        oss << line << "\n";
-#if 0
-        static std::int32_t image_count = 1;
-        const static std::string image_prefix = "[IMAGE] ";
-        const static auto image_prefix_size = std::size(image_prefix);
-
-        if (line.starts_with(image_prefix)) [[unlikely]] {
-          auto image_name = line.substr(image_prefix_size);
-
-          if (auto iter = image_name_map.find(image_name);
-              iter != std::end(image_name_map)) {
-            oss << image_prefix << iter->second << '\n';
-          } else {
-            if (!std::filesystem::exists(image_name)) {
-              klib::warn("Image not exists: {}", image_name);
-              continue;
-            }
-
-            auto ext = check_is_supported_format(image_name);
-
-            if (ext) {
-              auto new_image_name = num_to_str(image_count++) + *ext;
-              oss << image_prefix << new_image_name << '\n';
-              std::filesystem::rename(image_name, new_image_name);
-
-              image_name_map.emplace(image_name, new_image_name);
-            }
-          }
-        } else [[likely]] {
-          oss << line << '\n';
-        }
-#endif
+  if (!std::empty(buffer_) && buffer_.back() == '\n') {
+    buffer_.pop_back();
+  }
+  write(buffer_);
+  buffer_.clear();
+
+  const auto fd = std::exchange(fd_, -1);
+  if (::close(fd) == -1) {
+    klib::error("Failed to close file: '{}'", temp_name_);
+  }
+  if (std::rename(temp_name_.c_str(), file_name_.c_str()) == -1) {
+    klib::error("Failed to rename file '{}' to '{}'", temp_name_, file_name_);
+  }
+}
+
+void TxtWriter::append(std::string_view str) {
+  buffer_.append(str);
+  if (std::size(buffer_) >= buffer_size) {
+    flush();
+  }
+}
+
+void TxtWriter::flush() {
+  if (std::empty(buffer_)) {
+    return;
+  }
+
+  write(std::string_view(buffer_).substr(0, std::size(buffer_) - 1));
+  buffer_.erase(0, std::size(buffer_) - 1);
+}
+
+void TxtWriter::write(std::string_view str) {
+  while (!std::empty(str)) {
+    const auto size = ::write(fd_, std::data(str), std::size(str));
+    if (size == -1) {
+      if (errno == EINTR) {
+        continue;
       }
-      oss << "\n\n\n";
+      klib::error("Failed to write file");
     }
+    str.remove_prefix(static_cast<std::size_t>(size));
   }
+}
+
+OrderedTxtWriter::OrderedTxtWriter(const BookInfo &book_info,
+                                   std::vector<Volume> &volumes)
+    : writer_(make_book_name_legal(book_info.name_) + ".txt") {
+  writer_.write_book_info(book_info);
 
-  std::string str = oss.str();
-  // '\n'
-  str.pop_back();
+  for (auto &volume : volumes) {
+    offsets_.push_back(std::size(items_));
+    for (auto &chapter : volume.chapters_) {
+      items_.push_back({&volume.title_, &chapter});
+    }
+  }
+  done_.resize(std::size(items_));
+}
+
+void OrderedTxtWriter::done(std::size_t volume_index,
+                            std::size_t chapter_index) {
+  std::lock_guard lock(mutex_);
+
+  const auto index = offsets_[volume_index] + chapter_index;
+  Expects(index < std::size(items_) && !done_[index]);
+  done_[index] = true;
+
+  if (index != next_) {
+    return;
+  }
+
+  for (; next_ < std::size(items_) && done_[next_]; ++next_) {
+    auto &[volume_title, chapter] = items_[next_];
+    writer_.write_chapter(*volume_title, *chapter);
+    std::vector<std::string>().swap(chapter->texts_);
+  }
+  writer_.flush();
+}
+
+void OrderedTxtWriter::close() {
+  std::lock_guard lock(mutex_);
+
+  if (next_ != std::size(items_)) {
+    klib::warn("{} chapters are not downloaded",
+               std::size(items_) - next_);
+  }
+  writer_.close();
+}
+
+void generate_txt(const BookInfo &book_info,
+                  const std::vector<Volume> &volumes) {
+  TxtWriter writer(make_book_name_legal(book_info.name_) + ".txt");
+
+  writer.write_book_info(book_info);
+  for (const auto &volume : volumes) {
+    for (const auto &chapter : volume.chapters_) {
+      writer.write_chapter(volume.title_, chapter);
+    }
+  }
 
-  std::ofstream book_ofs(make_book_name_legal(book_info.name_) + ".txt");
-  book_ofs << str << std::flush;
+  writer.close();
 }
 
 }  // namespace kepub
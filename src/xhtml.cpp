@@ -0,0 +1,174 @@
+#include "xhtml.h"
+
+#include <immintrin.h>
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#include "util.h"
+
+namespace kepub {
+
+namespace {
+
+// pugixml escapes &, <, > and the control characters except \t, \r and \n in
+// text, and also ", \t, \r and \n in attribute values
+template <bool Attribute>
+bool is_special(std::uint8_t c) {
+  if (c < 32) {
+    return Attribute || (c != '\t' && c != '\r' && c != '\n');
+  }
+  return c == '&' || c == '<' || c == '>' || (Attribute && c == '"');
+}
+
+template <bool Attribute>
+void append_escaped(std::string &out, std::string_view str) {
+  const auto *ptr = std::data(str);
+  const auto *const last = ptr + std::size(str);
+  // The start of the bytes that are not appended yet
+  const auto *run = ptr;
+
+  while (ptr != last) {
+    // Skip 32 bytes at a time if none of them may need escaping
+    if (last - ptr >= 32) {
+      const auto bytes =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr));
+      auto special = _mm256_or_si256(
+          _mm256_cmpeq_epi8(
+              _mm256_min_epu8(bytes, _mm256_set1_epi8(31)), bytes),
+          _mm256_or_si256(
+              _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('&')),
+              _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('<')),
+                              _mm256_cmpeq_epi8(bytes,
+                                                _mm256_set1_epi8('>')))));
+      if constexpr (Attribute) {
+        special = _mm256_or_si256(
+            special, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"')));
+      }
+
+      const auto mask =
+          static_cast<std::uint32_t>(_mm256_movemask_epi8(special));
+      if (mask == 0) {
+        ptr += 32;
+        continue;
+      }
+      ptr += std::countr_zero(mask);
+    }
+
+    const auto c = static_cast<std::uint8_t>(*ptr);
+    if (!is_special<Attribute>(c)) {
+      ++ptr;
+      continue;
+    }
+
+    out.append(run, ptr);
+    ++ptr;
+    run = ptr;
+
+    switch (c) {
+      case '\0':
+        return;
+      case '&':
+        out.append("&amp;");
+        break;
+      case '<':
+        out.append("&lt;");
+        break;
+      case '>':
+        out.append("&gt;");
+        break;
+      case '"':
+        out.append("&quot;");
+        break;
+      default: {
+        const char entity[] = {'&', '#', static_cast<char>('0' + c / 10),
+                               static_cast<char>('0' + c % 10), ';'};
+        out.append(entity, std::size(entity));
+      }
+    }
+  }
+
+  out.append(run, last);
+}
+
+}  // namespace
+
+void append_escaped_text(std::string &out, std::string_view str) {
+  append_escaped<false>(out, str);
+}
+
+void append_escaped_attribute(std::string &out, std::string_view str) {
+  append_escaped<true>(out, str);
+}
+
+std::string generate_text_xhtml(std::string_view title,
+                                const std::vector<std::string> &texts,
+                                std::string_view epub_type) {
+  constexpr std::string_view head =
+      "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      "<html xmlns=\"http://www.w3.org/1999/xhtml\" "
+      "xmlns:epub=\"http://www.idpf.org/2007/ops\" xml:lang=\"zh-CN\">\n"
+      "  <head>\n"
+      "    <title>";
+  constexpr std::string_view link =
+      "</title>\n"
+      "    <link rel=\"stylesheet\" href=\"../css/style.css\" />\n"
+      "  </head>\n";
+  constexpr std::string_view h1 =
+      "    <div>\n"
+      "      <h1>";
+  constexpr std::string_view tail =
+      "    </div>\n"
+      "  </body>\n"
+      "</html>\n";
+
+  constexpr std::string_view image_prefix = "[IMAGE] ";
+
+  std::size_t size = 1024;
+  for (const auto &text : texts) {
+    size += std::size(text) + 16;
+  }
+
+  std::string result;
+  result.reserve(size);
+
+  result.append(head);
+  append_escaped_text(result, title);
+  result.append(link);
+
+  if (std::empty(epub_type)) {
+    result.append("  <body>\n");
+  } else {
+    result.append("  <body epub:type=\"");
+    append_escaped_attribute(result, epub_type);
+    result.append("\">\n");
+  }
+
+  result.append(h1);
+  append_escaped_text(result, title);
+  result.append("</h1>\n");
+
+  for (const auto &text : texts) {
+    if (text.starts_with(image_prefix)) [[unlikely]] {
+      const auto stem =
+          kepub::stem(std::string(text.substr(std::size(image_prefix))));
+
+      result.append("      <div class=\"center\">\n        <img alt=\"");
+      append_escaped_attribute(result, stem);
+      result.append("\" src=\"../image/");
+      append_escaped_attribute(result, stem);
+      result.append(".webp\" />\n      </div>\n");
+    } else {
+      result.append("      <p>");
+      append_escaped_text(result, text);
+      result.append("</p>\n");
+    }
+  }
+
+  result.append(tail);
+
+  return result;
+}
+
+}  // namespace kepub
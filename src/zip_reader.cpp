@@ -0,0 +1,213 @@
+#include "zip_reader.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <utility>
+
+#include <klib/log.h>
+
+namespace kepub {
+
+namespace {
+
+constexpr std::uint16_t stored = 0;
+constexpr std::uint16_t deflated = 8;
+
+constexpr std::uint16_t encrypted_flag = 1;
+
+constexpr std::size_t local_header_size = 30;
+constexpr std::size_t central_header_size = 46;
+constexpr std::size_t end_of_central_directory_size = 22;
+
+std::uint16_t get16(std::string_view data, std::size_t offset) {
+  return static_cast<std::uint16_t>(
+      static_cast<std::uint8_t>(data[offset]) |
+      (static_cast<std::uint8_t>(data[offset + 1]) << 8));
+}
+
+std::uint32_t get32(std::string_view data, std::size_t offset) {
+  return get16(data, offset) |
+         (static_cast<std::uint32_t>(get16(data, offset + 2)) << 16);
+}
+
+// Raw inflate, as a ZIP entry holds no zlib header
+std::string inflate(std::string_view data, std::size_t size) {
+  z_stream stream = {};
+  if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+    klib::error("inflateInit2() failed");
+  }
+
+  std::string result(size, '\0');
+  stream.next_in =
+      reinterpret_cast<Bytef *>(const_cast<char *>(std::data(data)));
+  stream.avail_in = static_cast<uInt>(std::size(data));
+  stream.next_out = reinterpret_cast<Bytef *>(std::data(result));
+  stream.avail_out = static_cast<uInt>(std::size(result));
+
+  const auto rc = ::inflate(&stream, Z_FINISH);
+  inflateEnd(&stream);
+  if (rc != Z_STREAM_END || stream.total_out != size) {
+    klib::error("inflate() failed");
+  }
+
+  return result;
+}
+
+}  // namespace
+
+ZipReader::ZipReader(const std::string &file_name)
+    : file_name_(file_name), ifs_(file_name, std::ifstream::binary) {
+  if (!ifs_) {
+    klib::error("Failed to open file: '{}'", file_name);
+  }
+  file_size_ = std::filesystem::file_size(file_name);
+
+  // The end of central directory record is followed by a comment of at most
+  // 65535 bytes
+  const auto tail_size = static_cast<std::size_t>(std::min<std::uint64_t>(
+      file_size_, end_of_central_directory_size + 65535));
+  std::string tail;
+  read_at(file_size_ - tail_size, tail, tail_size);
+
+  auto pos = std::string_view::npos;
+  for (auto i = static_cast<std::ptrdiff_t>(tail_size) -
+                static_cast<std::ptrdiff_t>(end_of_central_directory_size);
+       i >= 0; --i) {
+    if (get32(tail, static_cast<std::size_t>(i)) == 0x06054B50) {
+      pos = static_cast<std::size_t>(i);
+      break;
+    }
+  }
+  if (pos == std::string_view::npos) {
+    klib::error("Not a ZIP file: '{}'", file_name);
+  }
+
+  const auto entry_count = get16(tail, pos + 10);
+  const auto central_directory_size = get32(tail, pos + 12);
+  const auto central_directory_offset = get32(tail, pos + 16);
+  if (entry_count == 0xFFFF || central_directory_size == 0xFFFFFFFF ||
+      central_directory_offset == 0xFFFFFFFF) {
+    klib::error("ZIP64 is not supported: '{}'", file_name);
+  }
+  if (static_cast<std::uint64_t>(central_directory_offset) +
+          central_directory_size >
+      file_size_) {
+    klib::error("Invalid ZIP file: '{}'", file_name);
+  }
+
+  std::string central_directory;
+  read_at(central_directory_offset, central_directory, central_directory_size);
+
+  std::size_t offset = 0;
+  entries_.reserve(entry_count);
+  for (std::uint16_t i = 0; i < entry_count; ++i) {
+    if (std::size(central_directory) - offset < central_header_size ||
+        get32(central_directory, offset) != 0x02014B50) {
+      klib::error("Invalid ZIP file: '{}'", file_name);
+    }
+
+    ZipEntry entry;
+    entry.flags_ = get16(central_directory, offset + 8);
+    entry.method_ = get16(central_directory, offset + 10);
+    entry.time_ = get16(central_directory, offset + 12);
+    entry.date_ = get16(central_directory, offset + 14);
+    entry.crc32_ = get32(central_directory, offset + 16);
+    entry.compressed_size_ = get32(central_directory, offset + 20);
+    entry.size_ = get32(central_directory, offset + 24);
+    const std::size_t path_size = get16(central_directory, offset + 28);
+    const std::size_t extra_size = get16(central_directory, offset + 30);
+    const std::size_t comment_size = get16(central_directory, offset + 32);
+    entry.offset_ = get32(central_directory, offset + 42);
+
+    offset += central_header_size;
+    if (std::size(central_directory) - offset <
+        path_size + extra_size + comment_size) {
+      klib::error("Invalid ZIP file: '{}'", file_name);
+    }
+    entry.path_ = central_directory.substr(offset, path_size);
+    offset += path_size + extra_size + comment_size;
+
+    if (entry.flags_ & encrypted_flag) {
+      klib::error("Encrypted ZIP entry is not supported: '{}'", entry.path_);
+    }
+    if (entry.compressed_size_ == 0xFFFFFFFF || entry.size_ == 0xFFFFFFFF ||
+        entry.offset_ == 0xFFFFFFFF) {
+      klib::error("ZIP64 is not supported: '{}'", file_name);
+    }
+
+    entries_.push_back(std::move(entry));
+  }
+}
+
+const ZipEntry *ZipReader::find(std::string_view path) const {
+  const auto iter =
+      std::find_if(std::begin(entries_), std::end(entries_),
+                   [&](const ZipEntry &entry) { return entry.path_ == path; });
+  return iter == std::end(entries_) ? nullptr : &*iter;
+}
+
+std::string ZipReader::read(std::string_view path) {
+  const auto *entry = find(path);
+  if (entry == nullptr) {
+    klib::error("No entry '{}' in the ZIP file: '{}'", path, file_name_);
+  }
+
+  return read(*entry);
+}
+
+std::string ZipReader::read(const ZipEntry &entry) {
+  auto result = read_raw(entry);
+
+  if (entry.method_ == deflated) {
+    result = inflate(result, entry.size_);
+  } else if (entry.method_ != stored) {
+    klib::error("Unsupported compression method {}: '{}'", entry.method_,
+                entry.path_);
+  }
+
+  if (std::size(result) != entry.size_ ||
+      crc32_z(0, reinterpret_cast<const Bytef *>(std::data(result)),
+              std::size(result)) != entry.crc32_) {
+    klib::error("CRC-32 mismatch: '{}'", entry.path_);
+  }
+
+  return result;
+}
+
+std::string ZipReader::read_raw(const ZipEntry &entry) {
+  // The extra field in the local file header may differ from the one in the
+  // central directory
+  std::string header;
+  read_at(entry.offset_, header, local_header_size);
+  if (get32(header, 0) != 0x04034B50) {
+    klib::error("Invalid ZIP file: '{}'", file_name_);
+  }
+
+  const auto data_offset = static_cast<std::uint64_t>(entry.offset_) +
+                           local_header_size + get16(header, 26) +
+                           get16(header, 28);
+
+  std::string result;
+  read_at(data_offset, result, entry.compressed_size_);
+
+  return result;
+}
+
+void ZipReader::read_at(std::uint64_t offset, std::string &out,
+                        std::size_t size) {
+  if (offset > file_size_ || file_size_ - offset < size) {
+    klib::error("Invalid ZIP file: '{}'", file_name_);
+  }
+
+  out.resize(size);
+  ifs_.seekg(static_cast<std::streamoff>(offset));
+  ifs_.read(std::data(out), static_cast<std::streamsize>(size));
+  if (!ifs_) {
+    klib::error("Failed to read file: '{}'", file_name_);
+  }
+}
+
+}  // namespace kepub
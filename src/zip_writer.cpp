@@ -0,0 +1,214 @@
+#include "zip_writer.h"
+
+#include <zlib.h>
+
+#include <ctime>
+#include <limits>
+#include <utility>
+
+#include <klib/log.h>
+
+namespace kepub {
+
+namespace {
+
+constexpr std::uint16_t stored = 0;
+constexpr std::uint16_t deflated = 8;
+
+// Version 2.0, needed for deflate
+constexpr std::uint16_t version = 20;
+// The file name is UTF-8
+constexpr std::uint16_t utf8_flag = 1 << 11;
+
+void put16(std::string &out, std::uint16_t value) {
+  out.push_back(static_cast<char>(value & 0xFF));
+  out.push_back(static_cast<char>(value >> 8));
+}
+
+void put32(std::string &out, std::uint32_t value) {
+  put16(out, static_cast<std::uint16_t>(value & 0xFFFF));
+  put16(out, static_cast<std::uint16_t>(value >> 16));
+}
+
+std::uint32_t to_uint32(std::uint64_t value) {
+  if (value > std::numeric_limits<std::uint32_t>::max()) {
+    klib::error("The ZIP file is larger than 4GB");
+  }
+  return static_cast<std::uint32_t>(value);
+}
+
+// Raw deflate, as a ZIP entry holds no zlib header
+std::string deflate(std::string_view data) {
+  z_stream stream = {};
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    klib::error("deflateInit2() failed");
+  }
+
+  std::string result(deflateBound(&stream, static_cast<uLong>(std::size(data))),
+                     '\0');
+  stream.next_in =
+      reinterpret_cast<Bytef *>(const_cast<char *>(std::data(data)));
+  stream.avail_in = static_cast<uInt>(std::size(data));
+  stream.next_out = reinterpret_cast<Bytef *>(std::data(result));
+  stream.avail_out = static_cast<uInt>(std::size(result));
+
+  const auto rc = ::deflate(&stream, Z_FINISH);
+  deflateEnd(&stream);
+  if (rc != Z_STREAM_END) {
+    klib::error("deflate() failed");
+  }
+
+  result.resize(stream.total_out);
+  return result;
+}
+
+}  // namespace
+
+ZipWriter::ZipWriter(const std::string &file_name)
+    : file_name_(file_name),
+      ofs_(file_name, std::ofstream::binary | std::ofstream::trunc) {
+  if (!ofs_) {
+    klib::error("Failed to open file: '{}'", file_name);
+  }
+
+  // MS-DOS date and time
+  const auto now = std::time(nullptr);
+  std::tm tm;
+  localtime_r(&now, &tm);
+  time_ = static_cast<std::uint16_t>((tm.tm_hour << 11) | (tm.tm_min << 5) |
+                                     (tm.tm_sec / 2));
+  date_ = static_cast<std::uint16_t>(((tm.tm_year - 80) << 9) |
+                                     ((tm.tm_mon + 1) << 5) | tm.tm_mday);
+}
+
+void ZipWriter::add(std::string_view path, std::string_view data,
+                    bool compress) {
+  ZipEntry entry;
+  entry.path_ = path;
+  entry.flags_ = utf8_flag;
+  entry.time_ = time_;
+  entry.date_ = date_;
+  entry.crc32_ = static_cast<std::uint32_t>(
+      crc32_z(0, reinterpret_cast<const Bytef *>(std::data(data)),
+              std::size(data)));
+  entry.size_ = to_uint32(std::size(data));
+  entry.offset_ = to_uint32(offset_);
+
+  std::string compressed;
+  if (compress) {
+    compressed = deflate(data);
+  }
+  if (compress && std::size(compressed) < std::size(data)) {
+    entry.method_ = deflated;
+    data = compressed;
+  } else {
+    entry.method_ = stored;
+  }
+  entry.compressed_size_ = to_uint32(std::size(data));
+
+  write_local_header(entry);
+  write(data);
+
+  entries_.push_back(std::move(entry));
+}
+
+void ZipWriter::copy(ZipReader &reader, const ZipEntry &entry) {
+  const auto data = reader.read_raw(entry);
+
+  auto copied = entry;
+  // The sizes and CRC-32 are in the local file header, so there is no data
+  // descriptor after the data
+  copied.flags_ &= utf8_flag;
+  copied.offset_ = to_uint32(offset_);
+
+  write_local_header(copied);
+  write(data);
+
+  entries_.push_back(std::move(copied));
+}
+
+void ZipWriter::close() {
+  const auto central_directory_offset = to_uint32(offset_);
+
+  for (const auto &entry : entries_) {
+    buffer_.clear();
+    put32(buffer_, 0x02014B50);
+    // Made by UNIX
+    put16(buffer_, (3 << 8) | version);
+    put16(buffer_, version);
+    put16(buffer_, entry.flags_);
+    put16(buffer_, entry.method_);
+    put16(buffer_, entry.time_);
+    put16(buffer_, entry.date_);
+    put32(buffer_, entry.crc32_);
+    put32(buffer_, entry.compressed_size_);
+    put32(buffer_, entry.size_);
+    put16(buffer_, static_cast<std::uint16_t>(std::size(entry.path_)));
+    // Extra field, comment length, disk number and internal attributes
+    put16(buffer_, 0);
+    put16(buffer_, 0);
+    put16(buffer_, 0);
+    put16(buffer_, 0);
+    // -rw-r--r--
+    put32(buffer_, 0100644U << 16);
+    put32(buffer_, entry.offset_);
+    buffer_.append(entry.path_);
+
+    write(buffer_);
+  }
+
+  const auto central_directory_size =
+      to_uint32(offset_ - central_directory_offset);
+  const auto entry_count = static_cast<std::uint16_t>(std::size(entries_));
+  if (entry_count != std::size(entries_)) {
+    klib::error("Too many entries in the ZIP file");
+  }
+
+  buffer_.clear();
+  put32(buffer_, 0x06054B50);
+  // Disk numbers
+  put16(buffer_, 0);
+  put16(buffer_, 0);
+  put16(buffer_, entry_count);
+  put16(buffer_, entry_count);
+  put32(buffer_, central_directory_size);
+  put32(buffer_, central_directory_offset);
+  // Comment length
+  put16(buffer_, 0);
+  write(buffer_);
+
+  ofs_.close();
+  if (!ofs_) {
+    klib::error("Failed to write file: '{}'", file_name_);
+  }
+}
+
+void ZipWriter::write_local_header(const ZipEntry &entry) {
+  buffer_.clear();
+  put32(buffer_, 0x04034B50);
+  put16(buffer_, version);
+  put16(buffer_, entry.flags_);
+  put16(buffer_, entry.method_);
+  put16(buffer_, entry.time_);
+  put16(buffer_, entry.date_);
+  put32(buffer_, entry.crc32_);
+  put32(buffer_, entry.compressed_size_);
+  put32(buffer_, entry.size_);
+  put16(buffer_, static_cast<std::uint16_t>(std::size(entry.path_)));
+  // Extra field length
+  put16(buffer_, 0);
+  buffer_.append(entry.path_);
+
+  write(buffer_);
+}
+
+void ZipWriter::write(std::string_view data) {
+  ofs_.write(std::data(data), static_cast<std::streamsize>(std::size(data)));
+  if (!ofs_) {
+    klib::error("Failed to write file: '{}'", file_name_);
+  }
+  offset_ += std::size(data);
+}
+
+}  // namespace kepub
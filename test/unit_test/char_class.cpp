@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <klib/unicode.h>
+#include <catch2/catch.hpp>
+
+#include "char_class.h"
+
+namespace {
+
+// The same as str_check() and str_size() before classify()
+std::vector<char32_t> unknown_chars(const std::string &str) {
+  auto copy = str;
+  std::erase_if(copy, [](char c) { return std::isalnum(c) || c == ' '; });
+
+  std::vector<char32_t> result;
+  for (auto c : klib::utf8_to_utf32(copy)) {
+    if (!klib::is_cjk(c) && c != U'◇' && !klib::is_chinese_punctuation(c)) {
+      result.push_back(c);
+    }
+  }
+
+  return result;
+}
+
+std::int32_t cjk_count(const std::string &str) {
+  const auto utf32 = klib::utf8_to_utf32(str);
+  return static_cast<std::int32_t>(
+      std::count_if(std::begin(utf32), std::end(utf32),
+                    [](char32_t c) { return klib::is_cjk(c); }));
+}
+
+}  // namespace
+
+TEST_CASE("CharTable", "[char_class]") {
+  const auto &table = kepub::CharTable::get();
+
+  CHECK(table[U'a'] == kepub::CharClass::Ignored);
+  CHECK(table[U' '] == kepub::CharClass::Ignored);
+  CHECK(table[U'.'] == kepub::CharClass::Unknown);
+  CHECK(table[U'你'] == kepub::CharClass::Cjk);
+  CHECK(table[U'，'] == kepub::CharClass::Punctuation);
+  CHECK(table[U'◇'] == kepub::CharClass::Punctuation);
+  CHECK(table[U'あ'] == kepub::CharClass::Unknown);
+
+  CHECK(table.flags(U'a') ==
+        (kepub::CharTable::AsciiAlpha | kepub::CharTable::AsciiAlnum));
+  CHECK(table.flags(U'0') == kepub::CharTable::AsciiAlnum);
+  CHECK(table.flags(U'你') == kepub::CharTable::Cjk);
+  CHECK(table.flags(U'，') == (kepub::CharTable::Punctuation |
+                               kepub::CharTable::Closing |
+                               kepub::CharTable::Comma));
+  CHECK(table.flags(U'[') == kepub::CharTable::Opening);
+  CHECK(table.flags(U'◇') == 0);
+  CHECK(table.flags(0x1FFFFF) == 0);
+}
+
+TEST_CASE("classify", "[char_class]") {
+  std::array<kepub::UnknownChar, 2> unknown;
+
+  const std::string str = "Hello 你好，あ world ω.";
+  const auto count = kepub::classify(str, unknown);
+  CHECK(count.cjk_ == 2);
+  CHECK(count.unknown_ == 3);
+  CHECK(unknown[0].code_point_ == U'あ');
+  CHECK(unknown[0].offset_ == str.find("あ"));
+  CHECK(unknown[1].code_point_ == U'ω');
+
+  CHECK(kepub::count_cjk(str) == 2);
+  CHECK(kepub::classify("").cjk_ == 0);
+}
+
+TEST_CASE("classify is the same as klib", "[char_class]") {
+  std::array<kepub::UnknownChar, 64> unknown;
+
+  for (const auto &entry :
+       std::filesystem::recursive_directory_iterator("corpus")) {
+    if (entry.path().extension() != ".txt") {
+      continue;
+    }
+
+    std::ifstream ifs(entry.path());
+    std::string line;
+    while (std::getline(ifs, line)) {
+      const auto expected = unknown_chars(line);
+      const auto count = kepub::classify(line, unknown);
+
+      REQUIRE(count.cjk_ == cjk_count(line));
+      REQUIRE(kepub::count_cjk(line) == count.cjk_);
+      REQUIRE(count.unknown_ == std::size(expected));
+      for (std::size_t i = 0; i < std::min(count.unknown_, std::size(unknown));
+           ++i) {
+        REQUIRE(unknown[i].code_point_ == expected[i]);
+      }
+    }
+  }
+}
@@ -0,0 +1,42 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <opencc.h>
+#include <catch2/catch.hpp>
+
+#include "converter.h"
+
+TEST_CASE("convert", "[converter]") {
+  const kepub::Converter converter;
+
+  CHECK(converter.convert("") == "");
+  CHECK(converter.convert("安裝後") == "安装后");
+  CHECK(converter.convert("ABC 123") == "ABC 123");
+
+  CHECK(converter.may_convert("安裝後"));
+  CHECK_FALSE(converter.may_convert(""));
+  CHECK_FALSE(converter.may_convert("ABC 123"));
+}
+
+TEST_CASE("The same as OpenCC", "[converter]") {
+  const kepub::Converter converter;
+  const opencc::SimpleConverter opencc("/usr/local/share/opencc/tw2s.json");
+
+  for (const auto &entry :
+       std::filesystem::recursive_directory_iterator("corpus")) {
+    if (entry.path().extension() != ".txt") {
+      continue;
+    }
+
+    std::ifstream ifs(entry.path());
+    std::string line;
+    while (std::getline(ifs, line)) {
+      const auto converted = opencc.Convert(line);
+      REQUIRE(converter.convert(line) == converted);
+      if (!converter.may_convert(line)) {
+        REQUIRE(converted == line);
+      }
+    }
+  }
+}
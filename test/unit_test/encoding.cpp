@@ -0,0 +1,83 @@
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <klib/util.h>
+#include <catch2/catch.hpp>
+
+#include "encoding.h"
+#include "txt_parser.h"
+
+namespace {
+
+// 我的第一章，他說了這是不對的。abc
+const std::string utf8 =
+    "\xE6\x88\x91\xE7\x9A\x84\xE7\xAC\xAC\xE4\xB8\x80\xE7\xAB\xA0\xEF\xBC\x8C"
+    "\xE4\xBB\x96\xE8\xAA\xAA\xE4\xBA\x86\xE9\x80\x99\xE6\x98\xAF\xE4\xB8\x8D"
+    "\xE5\xB0\x8D\xE7\x9A\x84\xE3\x80\x82"
+    "abc";
+const std::string gb18030 =
+    "\xCE\xD2\xB5\xC4\xB5\xDA\xD2\xBB\xD5\xC2\xA3\xAC\xCB\xFB\xD5\x66\xC1\xCB"
+    "\xDF\x40\xCA\xC7\xB2\xBB\x8C\xA6\xB5\xC4\xA1\xA3"
+    "abc";
+const std::string big5 =
+    "\xA7\xDA\xAA\xBA\xB2\xC4\xA4\x40\xB3\xB9\xA1\x41\xA5\x4C\xBB\xA1\xA4\x46"
+    "\xB3\x6F\xAC\x4F\xA4\xA3\xB9\xEF\xAA\xBA\xA1\x43"
+    "abc";
+
+std::string transcode(kepub::Encoding encoding, std::string_view data) {
+  kepub::Transcoder transcoder(encoding);
+
+  std::string result;
+  CHECK(transcoder.transcode(data, result) == std::size(data));
+  return result;
+}
+
+}  // namespace
+
+TEST_CASE("detect_encoding", "[encoding]") {
+  CHECK(kepub::detect_encoding(utf8) == kepub::Encoding::Utf8);
+  CHECK(kepub::detect_encoding(utf8.substr(0, 2)) == kepub::Encoding::Utf8);
+  CHECK(kepub::detect_encoding("") == kepub::Encoding::Utf8);
+
+  CHECK(kepub::detect_encoding(gb18030) == kepub::Encoding::Gb18030);
+  CHECK(kepub::detect_encoding(big5) == kepub::Encoding::Big5);
+}
+
+TEST_CASE("Transcoder", "[encoding]") {
+  CHECK(transcode(kepub::Encoding::Gb18030, gb18030) == utf8);
+  CHECK(transcode(kepub::Encoding::Big5, big5) == utf8);
+
+  // The trail byte 'f' starts a run of ASCII
+  const std::string ascii(100, 'a');
+  CHECK(transcode(kepub::Encoding::Gb18030, "\xD5\x66" + ascii) ==
+        "\xE8\xAA\xAA" + ascii);
+  // A four byte sequence
+  CHECK(transcode(kepub::Encoding::Gb18030, "\x95\x32\x82\x36" + ascii) ==
+        "\xF0\xA0\x80\x80" + ascii);
+
+  kepub::Transcoder transcoder(kepub::Encoding::Gb18030);
+  std::string result;
+  CHECK(transcoder.transcode(gb18030.substr(0, 3), result) == 2);
+  CHECK(result == utf8.substr(0, 3));
+  CHECK(transcoder.transcode(gb18030.substr(2), result) ==
+        std::size(gb18030) - 2);
+  CHECK(result == utf8);
+}
+
+TEST_CASE("parse GB18030 file", "[encoding]") {
+  klib::write_file("encoding.txt", false,
+                   "[WEB] " + gb18030 + "\n" + gb18030 + "\n");
+
+  std::vector<std::string> result;
+  kepub::TxtHandler handler;
+  handler.chapter_ = [&](std::string title, std::vector<std::string> texts) {
+    result.push_back(title);
+    result.insert(std::end(result), std::begin(texts), std::end(texts));
+  };
+
+  kepub::TxtParser parser(handler, false);
+  parser.parse_file("encoding.txt");
+  CHECK(result == std::vector<std::string>{utf8, utf8});
+}
@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <filesystem>
 #include <memory>
 
@@ -6,6 +7,7 @@
 #include <catch2/catch.hpp>
 
 #include "epub.h"
+#include "zip_reader.h"
 
 TEST_CASE("base generate", "[epub]") {
   kepub::Epub epub;
@@ -1234,3 +1236,101 @@ introduction</dc:description>
 
   std::filesystem::remove_all("test book8");
 }
+
+TEST_CASE("append to EPUB file", "[epub]") {
+  kepub::Epub epub;
+  epub.set_rights("Kaiser");
+
+  kepub::Novel novel;
+  novel.book_info_.name_ = "test book9";
+  novel.book_info_.author_ = "test author";
+  novel.book_info_.introduction_ = {"test", "introduction"};
+  novel.book_info_.cover_path_ = "cover.jpg";
+
+  novel.volumes_.emplace_back(
+      "volume 1", std::vector<kepub::Chapter>{kepub::Chapter(
+                      "title 1", std::vector<std::string>{"abc 1"})});
+
+  epub.set_novel(novel);
+  CHECK_NOTHROW(epub.generate());
+  std::filesystem::rename("test book9.epub", "test book9-back-up.epub");
+
+  novel.volumes_.clear();
+  novel.volumes_.emplace_back(
+      "volume 2", std::vector<kepub::Chapter>{kepub::Chapter(
+                      "title 2", std::vector<std::string>{"abc 2"})});
+
+  epub.set_novel(novel);
+  CHECK_NOTHROW(epub.append("test book9-back-up.epub"));
+
+  kepub::ZipReader from("test book9-back-up.epub");
+  kepub::ZipReader reader("test book9.epub");
+  REQUIRE(std::size(reader.entries()) == std::size(from.entries()) + 2);
+  CHECK(reader.entries().front().path_ == kepub::Epub::mimetype_path);
+  CHECK(reader.entries().front().method_ == 0);
+
+  // Unchanged entries are copied as they are
+  const auto *cover = reader.find("EPUB/image/cover.webp");
+  REQUIRE(cover != nullptr);
+  CHECK(reader.read_raw(*cover) ==
+        from.read_raw(*from.find("EPUB/image/cover.webp")));
+  CHECK(reader.read("EPUB/text/chapter001.xhtml") ==
+        from.read("EPUB/text/chapter001.xhtml"));
+
+  CHECK(reader.read("EPUB/text/volume002.xhtml").find("<h1>volume 2</h1>") !=
+        std::string::npos);
+  CHECK(reader.read("EPUB/text/chapter002.xhtml").find("<p>abc 2</p>") !=
+        std::string::npos);
+
+  const auto package = reader.read(kepub::Epub::package_opf_path);
+  CHECK(package.find(R"(<item id="chapter002.xhtml")") != std::string::npos);
+  CHECK(package.find(R"(<itemref idref="volume002.xhtml" />)") !=
+        std::string::npos);
+
+  const auto nav = reader.read(kepub::Epub::nav_xhtml_path);
+  CHECK(nav.find(R"(<a href="text/chapter002.xhtml">title 2</a>)") !=
+        std::string::npos);
+
+  std::filesystem::remove("test book9.epub");
+  std::filesystem::remove("test book9-back-up.epub");
+}
+
+TEST_CASE("font cache", "[epub]") {
+  const auto cache_dir = std::filesystem::current_path() / "test cache";
+  REQUIRE(setenv("XDG_CACHE_HOME", cache_dir.c_str(), 1) == 0);
+
+  kepub::Novel novel;
+  novel.book_info_.name_ = "test book10";
+  novel.book_info_.author_ = "test author";
+  novel.volumes_.emplace_back(
+      "volume 1", std::vector<kepub::Chapter>{kepub::Chapter(
+                      "title 1", std::vector<std::string>{"abc 1"})});
+
+  std::string fonts[2];
+  for (auto &font : fonts) {
+    kepub::Epub epub;
+    epub.set_uuid("5208e6bb-5d25-45b0-a7fd-b97d79a85fd4");
+    epub.set_novel(novel);
+    CHECK_NOTHROW(epub.generate());
+
+    font = klib::read_file(std::filesystem::path("test book10") /
+                               kepub::Epub::font_woff2_path,
+                           true);
+  }
+
+  CHECK(fonts[0] == fonts[1]);
+
+  std::size_t count = 0;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(cache_dir / "kepub")) {
+    CHECK(entry.path().extension() == ".woff2");
+    CHECK(klib::read_file(entry.path(), true) == fonts[0]);
+    ++count;
+  }
+  CHECK(count == 1);
+
+  REQUIRE(unsetenv("XDG_CACHE_HOME") == 0);
+  std::filesystem::remove_all(cache_dir);
+  std::filesystem::remove_all("test book10");
+  std::filesystem::remove("test book10.epub");
+}
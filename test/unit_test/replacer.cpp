@@ -0,0 +1,22 @@
+#include <string>
+
+#include <catch2/catch.hpp>
+
+#include "replacer.h"
+
+TEST_CASE("replace", "[replacer]") {
+  const kepub::Replacer replacer(
+      {{"赤果", "赤裸"}, {"赤果果", "赤裸裸"}, {"果然", "果真"}, {"ab", "x"}});
+
+  auto replace = [&](std::string str) {
+    replacer.replace(str);
+    return str;
+  };
+
+  CHECK(replace("") == "");
+  CHECK(replace("无需替换") == "无需替换");
+  CHECK(replace("赤果果的") == "赤裸裸的");
+  CHECK(replace("赤果然") == "赤裸然");
+  CHECK(replace("赤果赤果果") == "赤裸赤裸裸");
+  CHECK(replace("aabab") == "axx");
+}
@@ -1,3 +1,9 @@
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
 #include <catch2/catch.hpp>
 
 #include "trans.h"
@@ -9,4 +15,89 @@ TEST_CASE("trans_str", "[trans]") {
   CHECK(kepub::trans_str("安裝後?", true) == "安装后？");
   CHECK(kepub::trans_str("，，，", false) == "，");
   CHECK(kepub::trans_str("安　装", false) == "安 装");
+  CHECK(kepub::trans_str("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz "
+                         "0123456789 , 你好",
+                         false) ==
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz 0123456789，你好");
+  CHECK(kepub::trans_str("赤果果的廿卅", false) == "赤裸裸的二十三十");
+}
+
+TEST_CASE("trans_lines", "[trans]") {
+  std::vector<std::string> lines = {"安裝後?", "", " Ｑ０ ", "赤果果"};
+  kepub::trans_lines(lines, true);
+  CHECK(lines == std::vector<std::string>{"安装后？", "", "Q0", "赤裸裸"});
+
+  lines = {"安裝\n後", "安裝後"};
+  kepub::trans_lines(lines, true);
+  CHECK(lines == std::vector<std::string>{kepub::trans_str("安裝\n後", true),
+                                          "安装后"});
+
+  // Only the lines that change are stored
+  const std::vector<std::string_view> views = {"安裝後?", "不变", " Ｑ０ ", ""};
+  std::vector<std::optional<std::string>> changed(std::size(views), "old");
+  kepub::trans_lines(views, changed, true);
+  CHECK(changed[0] == "安装后？");
+  CHECK(!changed[1]);
+  CHECK(changed[2] == "Q0");
+  CHECK(!changed[3]);
+}
+
+TEST_CASE("trans_chapter", "[trans]") {
+  kepub::Chapter chapter("第一章 安裝", {"安裝後?", "", "&amp;"});
+  kepub::trans_chapter(chapter, true);
+
+  CHECK(chapter.title_ == "第一章 安装");
+  CHECK(chapter.texts_ == std::vector<std::string>{"安装后？", "&"});
+}
+
+TEST_CASE("load_replace_dict", "[trans]") {
+  {
+    std::ofstream ofs("replace-dict.txt");
+    ofs << "# comment\n"
+           "\n"
+           "a,b?\tX\n"
+           "空格 测试\t间 隔\r\n"
+           "删除\t\n"
+           "no tab\n";
+  }
+  kepub::load_replace_dict("replace-dict.txt");
+
+  // Matched against the normalized text, whatever the punctuation
+  CHECK(kepub::trans_str("a,b?", false) == "X");
+  CHECK(kepub::trans_str("a，b？", false) == "X");
+  CHECK(kepub::trans_str("空格 测试", false) == "间 隔");
+  CHECK(kepub::trans_str("要删除的", false) == "要的");
+  CHECK(kepub::trans_str("no tab", false) == "no tab");
+  CHECK(kepub::trans_str("赤果果", false) == "赤裸裸");
+
+  {
+    std::ofstream ofs("replace-dict.txt");
+  }
+  kepub::load_replace_dict("replace-dict.txt");
+  CHECK(kepub::trans_str("a,b?", false) == "a，b？");
+}
+
+TEST_CASE("trans_stats", "[trans]") {
+  const std::vector<std::string> batch = {"統計測試", "abc", "", "赤果果",
+                                          "測試統計"};
+
+  const auto before = kepub::trans_stats();
+  auto lines = batch;
+  kepub::trans_lines(lines, true);
+  const auto after = kepub::trans_stats();
+
+  CHECK(after.lines_ - before.lines_ == 5);
+  CHECK(after.skipped_ - before.skipped_ == 3);
+  CHECK(after.cache_hits_ == before.cache_hits_);
+
+  // Found in the cache, but counted the same
+  lines = batch;
+  kepub::trans_lines(lines, true);
+  CHECK(kepub::trans_str("統計測試", true) == lines.front());
+  const auto cached = kepub::trans_stats();
+
+  CHECK(cached.lines_ - after.lines_ == 6);
+  CHECK(cached.skipped_ - after.skipped_ == 3);
+  CHECK(cached.cache_hits_ - after.cache_hits_ == 3);
+  CHECK(cached.cache_misses_ == after.cache_misses_);
 }
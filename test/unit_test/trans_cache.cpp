@@ -0,0 +1,42 @@
+#include <cstdint>
+#include <string>
+
+#include <catch2/catch.hpp>
+
+#include "trans_cache.h"
+
+TEST_CASE("TransCache", "[trans_cache]") {
+  kepub::TransCache cache;
+
+  CHECK_FALSE(cache.get("安裝", true));
+  cache.put("安裝", true, "安装");
+  CHECK(cache.get("安裝", true) == "安装");
+  CHECK_FALSE(cache.get("安裝", false));
+
+  const std::string long_str(kepub::TransCache::max_str_size + 1, 'a');
+  cache.put(long_str, false, long_str);
+  CHECK_FALSE(cache.get(long_str, false));
+
+  CHECK(cache.hits() == 1);
+  CHECK(cache.misses() == 2);
+
+  cache.clear();
+  CHECK_FALSE(cache.get("安裝", true));
+}
+
+TEST_CASE("TransCache is bounded", "[trans_cache]") {
+  kepub::TransCache cache(64);
+
+  for (std::int32_t i = 0; i < 10000; ++i) {
+    cache.put(std::to_string(i), false, std::to_string(i));
+  }
+
+  std::int32_t count = 0;
+  for (std::int32_t i = 0; i < 10000; ++i) {
+    if (auto result = cache.get(std::to_string(i), false); result) {
+      CHECK(*result == std::to_string(i));
+      ++count;
+    }
+  }
+  CHECK(count <= 64);
+}
@@ -0,0 +1,88 @@
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "novel.h"
+#include "txt_parser.h"
+
+namespace {
+
+kepub::Novel parse(std::string_view data, std::size_t chunk_size,
+                   bool with_book_info = true) {
+  kepub::Novel novel;
+
+  kepub::TxtHandler handler;
+  if (with_book_info) {
+    handler.author_ = [&](std::string author) {
+      novel.book_info_.author_ = author;
+    };
+    handler.introduction_ = [&](std::string line) {
+      novel.book_info_.introduction_.push_back(line);
+    };
+    handler.postscript_ = [&](std::string line) {
+      novel.postscript_.push_back(line);
+    };
+  }
+  handler.volume_ = [&](std::string name) { novel.volumes_.emplace_back(name); };
+  handler.chapter_ = [&](std::string title, std::vector<std::string> texts) {
+    if (std::empty(novel.volumes_)) {
+      novel.volumes_.emplace_back();
+    }
+    novel.volumes_.back().chapters_.emplace_back(title, texts);
+  };
+
+  kepub::TxtParser parser(handler, false);
+  for (std::size_t i = 0; i < std::size(data); i += chunk_size) {
+    parser.feed(data.substr(i, chunk_size));
+  }
+  parser.finish();
+
+  return novel;
+}
+
+}  // namespace
+
+TEST_CASE("TxtParser", "[txt_parser]") {
+  constexpr std::string_view data = "ignored\n"
+                                    "[AUTHOR]\n"
+                                    "作者\n"
+                                    "[INTRO]\n"
+                                    "简介\n"
+                                    "\n"
+                                    "[WEB] 第一章 标题\n"
+                                    "内容1\n"
+                                    "[VOLUME] 第一卷 卷名\n"
+                                    "[WEB] 第二章 标题\n"
+                                    "[POST]\n"
+                                    "后记";
+
+  for (std::size_t chunk_size : {1, 5, 4096}) {
+    const auto novel = parse(data, chunk_size);
+
+    CHECK(novel.book_info_.author_ == "作者");
+    CHECK(novel.book_info_.introduction_ == std::vector<std::string>{"简介"});
+    CHECK(novel.postscript_ == std::vector<std::string>{"后记"});
+
+    REQUIRE(std::size(novel.volumes_) == 2);
+    CHECK(std::empty(novel.volumes_[0].title_));
+    REQUIRE(std::size(novel.volumes_[0].chapters_) == 1);
+    CHECK(novel.volumes_[0].chapters_[0].title_ == "第一章 标题");
+    CHECK(novel.volumes_[0].chapters_[0].texts_ ==
+          std::vector<std::string>{"内容1"});
+
+    CHECK(novel.volumes_[1].title_ == "第一卷 卷名");
+    REQUIRE(std::size(novel.volumes_[1].chapters_) == 1);
+    CHECK(novel.volumes_[1].chapters_[0].title_ == "第二章 标题");
+    CHECK(std::empty(novel.volumes_[1].chapters_[0].texts_));
+  }
+
+  // Without a callback the prefix is an ordinary line
+  const auto novel = parse("[WEB] 标题\n[AUTHOR]\n内容\n", 4096, false);
+  REQUIRE(std::size(novel.volumes_) == 1);
+  REQUIRE(std::size(novel.volumes_[0].chapters_) == 1);
+  CHECK(novel.volumes_[0].chapters_[0].texts_ ==
+        std::vector<std::string>{"[AUTHOR]", "内容"});
+}
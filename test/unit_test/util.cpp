@@ -1,6 +1,9 @@
+#include <filesystem>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
+#include <klib/util.h>
 #include <catch2/catch.hpp>
 
 #include "util.h"
@@ -33,3 +36,177 @@ TEST_CASE("push_back", "[util]") {
 
   REQUIRE(texts.front() == "第1卷");
 }
+
+TEST_CASE("Diagnostics", "[util]") {
+  kepub::Diagnostics diagnostics;
+  diagnostics.add_unknown(U'あ', "あい");
+  diagnostics.add_unknown(U'い', "あい", 2);
+  diagnostics.add_unknown(U'あ', "かあ", 1, "volume 1");
+
+  const auto unknown_characters = diagnostics.unknown_characters();
+  REQUIRE(std::size(unknown_characters) == 2);
+  CHECK(unknown_characters[0].code_point_ == U'あ');
+  CHECK(unknown_characters[0].count_ == 2);
+  CHECK(unknown_characters[0].line_ == "あい");
+  CHECK(std::empty(unknown_characters[0].location_));
+  CHECK(unknown_characters[1].code_point_ == U'い');
+  CHECK(unknown_characters[1].count_ == 2);
+}
+
+TEST_CASE("location", "[util]") {
+  CHECK(kepub::location(0) == "volume 1");
+  CHECK(kepub::location(0, 1) == "volume 1, chapter 2");
+  CHECK(kepub::location(1, 0, "第一章 标题") ==
+        "volume 2, chapter 1 '第一章 标题'");
+}
+
+TEST_CASE("WarningBuffer", "[util]") {
+  kepub::WarningBuffer buffer(kepub::location(0, 2, "第三章"));
+  {
+    kepub::WarningBuffer::Scope scope(buffer);
+    kepub::str_check("标题ω");
+    kepub::str_check("ωω内容");
+  }
+
+  kepub::Diagnostics diagnostics;
+  buffer.flush(&diagnostics);
+
+  const auto unknown_characters = diagnostics.unknown_characters();
+  REQUIRE(std::size(unknown_characters) == 1);
+  CHECK(unknown_characters[0].code_point_ == U'ω');
+  CHECK(unknown_characters[0].count_ == 3);
+  CHECK(unknown_characters[0].line_ == "标题ω");
+  CHECK(unknown_characters[0].location_ == "volume 1, chapter 3 '第三章'");
+}
+
+TEST_CASE("ParagraphAssembler", "[util]") {
+  const std::vector<std::string> lines = {
+      "第一句，", "第二句", "。", "abc", "def", "你好", "", "！", "（括号）",
+      "最后，",   "？"};
+
+  for (auto connect : {false, true}) {
+    std::vector<std::string> texts;
+    kepub::ParagraphAssembler assembler(connect, false);
+    for (const auto &line : lines) {
+      kepub::push_back(texts, line, connect, false);
+      assembler.add(line);
+    }
+
+    CHECK(assembler.take() == texts);
+    CHECK(std::empty(assembler.take()));
+  }
+
+  kepub::ParagraphAssembler assembler(true, false);
+  for (const auto &line : lines) {
+    assembler.add(line);
+  }
+  CHECK(assembler.take() ==
+        std::vector<std::string>{"第一句，第二句。", "abc def 你好！",
+                                 "（括号）", "最后，", "？"});
+}
+
+TEST_CASE("check_titles", "[util]") {
+  CHECK(kepub::is_regular_volume_name("第三十二卷 标题"));
+  CHECK_FALSE(kepub::is_regular_volume_name("第1234卷 标题"));
+  CHECK(kepub::is_regular_title("第123话 标题"));
+  CHECK_FALSE(kepub::is_regular_title("第一章 "));
+  CHECK_FALSE(kepub::is_regular_title("第123话标题"));
+
+  const std::vector<std::string> texts;
+  kepub::Novel novel;
+  novel.volumes_.emplace_back(
+      std::vector<kepub::Chapter>{{"第一章 标题", texts}, {"序章", texts}});
+  novel.volumes_.emplace_back("第一卷 卷ω",
+                              std::vector<kepub::Chapter>{{"第二章 ωω", texts}});
+
+  const auto issues = kepub::check_titles(novel);
+  REQUIRE(std::size(issues) == 3);
+
+  CHECK(issues[0].kind_ == kepub::TitleIssue::Kind::IrregularTitle);
+  CHECK(issues[0].volume_index_ == 0);
+  CHECK(issues[0].chapter_index_ == 1);
+  CHECK(issues[0].text_ == "序章");
+
+  CHECK(issues[1].kind_ == kepub::TitleIssue::Kind::UnknownCharacter);
+  CHECK(issues[1].volume_index_ == 1);
+  CHECK_FALSE(issues[1].chapter_index_.has_value());
+  CHECK(issues[1].code_point_ == U'ω');
+
+  CHECK(issues[2].kind_ == kepub::TitleIssue::Kind::UnknownCharacter);
+  CHECK(issues[2].chapter_index_ == 0);
+}
+
+TEST_CASE("TxtWriter", "[util]") {
+  kepub::BookInfo book_info;
+  book_info.name_ = "name";
+  book_info.author_ = "author";
+  book_info.source_ = "菠萝包";
+  book_info.introduction_ = {"intro"};
+
+  kepub::TxtWriter writer("txt_writer.txt");
+  writer.write_book_info(book_info);
+  writer.write_chapter(
+      "volume", kepub::Chapter("title", std::vector<std::string>{"a", "b"}));
+  writer.write_chapter("",
+                       kepub::Chapter("title", std::vector<std::string>{"c"}));
+  writer.close();
+  writer.close();
+
+  const auto expected =
+      "name\n作者：author\n来源：菠萝包\n简介：\nintro\n\n\n\n\n\n"
+      "volume : title\n\n　　a\n　　b\n\n\n\ntitle\n\n　　c\n\n\n";
+  CHECK(klib::read_file("txt_writer.txt", false) == expected);
+
+  // The book is only replaced once it is written
+  try {
+    kepub::TxtWriter failed("txt_writer.txt");
+    failed.write_book_info(book_info);
+    throw std::runtime_error("failed");
+  } catch (const std::runtime_error &) {
+  }
+  CHECK(klib::read_file("txt_writer.txt", false) == expected);
+  for (const auto &entry : std::filesystem::directory_iterator(".")) {
+    CHECK_FALSE(
+        entry.path().filename().string().starts_with("txt_writer.txt."));
+  }
+
+  {
+    kepub::TxtWriter unclosed("txt_writer.txt");
+    unclosed.write_chapter(
+        "", kepub::Chapter("title", std::vector<std::string>{"c"}));
+  }
+  CHECK(klib::read_file("txt_writer.txt", false) == "title\n\nc\n\n\n");
+}
+
+TEST_CASE("OrderedTxtWriter", "[util]") {
+  kepub::BookInfo book_info;
+  book_info.name_ = "ordered_txt_writer";
+
+  std::vector<kepub::Volume> volumes;
+  volumes.emplace_back("volume");
+  volumes.emplace_back("");
+  volumes.emplace_back("empty");
+  for (auto &volume : volumes) {
+    if (volume.title_ != "empty") {
+      volume.chapters_.emplace_back("title", std::vector<std::string>{"a"});
+      volume.chapters_.emplace_back("title", std::vector<std::string>{"b"});
+    }
+  }
+
+  kepub::generate_txt(book_info, volumes);
+  const auto expected = klib::read_file("ordered_txt_writer.txt", false);
+  std::filesystem::remove("ordered_txt_writer.txt");
+
+  kepub::OrderedTxtWriter writer(book_info, volumes);
+  writer.done(1, 1);
+  writer.done(0, 1);
+  CHECK(std::size(volumes[0].chapters_[1].texts_) == 1);
+  writer.done(0, 0);
+  CHECK(std::empty(volumes[0].chapters_[1].texts_));
+  CHECK(std::size(volumes[1].chapters_[1].texts_) == 1);
+  writer.done(1, 0);
+  CHECK(std::empty(volumes[1].chapters_[1].texts_));
+  writer.close();
+
+  CHECK(klib::read_file("ordered_txt_writer.txt", false) == expected);
+}
@@ -0,0 +1,117 @@
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <pugixml.hpp>
+
+#include "xhtml.h"
+
+namespace {
+
+class StringWriter : public pugi::xml_writer {
+ public:
+  explicit StringWriter(std::string &str) : str_(str) {}
+
+  void write(const void *data, std::size_t size) override {
+    str_.append(static_cast<const char *>(data), size);
+  }
+
+ private:
+  std::string &str_;
+};
+
+// The document the EPUB generator built before generate_text_xhtml()
+std::string save_with_pugixml(const std::string &title,
+                              const std::vector<std::string> &texts,
+                              const std::string &epub_type = "") {
+  pugi::xml_document doc;
+  auto decl = doc.prepend_child(pugi::node_declaration);
+  decl.append_attribute("version") = "1.0";
+  decl.append_attribute("encoding") = "UTF-8";
+
+  auto html = doc.append_child("html");
+  html.append_attribute("xmlns") = "http://www.w3.org/1999/xhtml";
+  html.append_attribute("xmlns:epub") = "http://www.idpf.org/2007/ops";
+  html.append_attribute("xml:lang") = "zh-CN";
+
+  auto head = html.append_child("head");
+  head.append_child("title").text() = title.c_str();
+
+  auto link = head.append_child("link");
+  link.append_attribute("rel") = "stylesheet";
+  link.append_attribute("href") = "../css/style.css";
+
+  auto body = html.append_child("body");
+  if (!std::empty(epub_type)) {
+    body.append_attribute("epub:type") = epub_type.c_str();
+  }
+
+  auto div = body.append_child("div");
+  div.append_child("h1").text() = title.c_str();
+
+  for (const auto &text : texts) {
+    if (text.starts_with("[IMAGE] ")) {
+      auto stem = text.substr(8, text.find_last_of('.') - 8);
+
+      auto d = div.append_child("div");
+      d.append_attribute("class") = "center";
+      auto img = d.append_child("img");
+      img.append_attribute("alt") = stem.c_str();
+      img.append_attribute("src") = ("../image/" + stem + ".webp").c_str();
+    } else {
+      div.append_child("p").text() = text.c_str();
+    }
+  }
+
+  std::string result;
+  StringWriter writer(result);
+  doc.save(writer, "  ");
+
+  return result;
+}
+
+}  // namespace
+
+TEST_CASE("escape like pugixml", "[xhtml]") {
+  std::string str;
+  kepub::append_escaped_text(str, "a&b<c>d\"e'f\tg\rh\ni\x01j\x1Fk");
+  CHECK(str == "a&amp;b&lt;c&gt;d\"e'f\tg\rh\ni&#01;j&#31;k");
+
+  str.clear();
+  kepub::append_escaped_attribute(str, "a&b<c>d\"e'f\tg\rh\ni\x01j");
+  CHECK(str == "a&amp;b&lt;c&gt;d&quot;e'f&#09;g&#13;h&#10;i&#01;j");
+
+  str.clear();
+  kepub::append_escaped_text(str, std::string_view("ab\0cd", 5));
+  CHECK(str == "ab");
+
+  // Longer than one vector, with special characters on both sides of the
+  // boundaries
+  std::string long_str;
+  std::string expected;
+  for (std::size_t i = 0; i < 100; ++i) {
+    long_str += i % 7 == 0 ? "<&>" : "测试";
+    expected += i % 7 == 0 ? "&lt;&amp;&gt;" : "测试";
+  }
+  str.clear();
+  kepub::append_escaped_text(str, long_str);
+  CHECK(str == expected);
+}
+
+TEST_CASE("generate_text_xhtml()", "[xhtml]") {
+  const std::vector<std::string> texts{"少女拖着消瘦的如枯木般的肢体跑着。",
+                                       "[IMAGE] 004.jpg",
+                                       "",
+                                       "a < b && c > d \"e\"",
+                                       "[IMAGE] a&b.png",
+                                       std::string(70, 'x') + "<"};
+
+  CHECK(kepub::generate_text_xhtml("第一章 序", texts) ==
+        save_with_pugixml("第一章 序", texts));
+  CHECK(kepub::generate_text_xhtml("简介", texts, "introduction") ==
+        save_with_pugixml("简介", texts, "introduction"));
+  CHECK(kepub::generate_text_xhtml("第一卷 <&>", {}) ==
+        save_with_pugixml("第一卷 <&>", {}));
+}
@@ -0,0 +1,54 @@
+#include <string>
+
+#include <catch2/catch.hpp>
+
+#include "zip_reader.h"
+#include "zip_writer.h"
+
+TEST_CASE("ZipReader", "[zip_reader]") {
+  const std::string text(1000, 'a');
+
+  {
+    kepub::ZipWriter writer("zip_reader.zip");
+    writer.add("mimetype", "application/epub+zip", false);
+    writer.add("EPUB/text.txt", text);
+    writer.add("EPUB/empty.txt", "");
+    writer.close();
+  }
+
+  kepub::ZipReader reader("zip_reader.zip");
+  REQUIRE(std::size(reader.entries()) == 3);
+  CHECK(reader.entries()[0].path_ == "mimetype");
+  CHECK(reader.entries()[0].method_ == 0);
+  CHECK(reader.entries()[1].method_ == 8);
+  CHECK(reader.entries()[1].size_ == std::size(text));
+  CHECK(reader.find("EPUB/none.txt") == nullptr);
+
+  CHECK(reader.read("mimetype") == "application/epub+zip");
+  CHECK(reader.read("EPUB/text.txt") == text);
+  CHECK(std::empty(reader.read("EPUB/empty.txt")));
+  CHECK(std::size(reader.read_raw(reader.entries()[1])) ==
+        reader.entries()[1].compressed_size_);
+
+  // Copied entries keep their compressed data
+  {
+    kepub::ZipWriter writer("zip_reader_copy.zip");
+    for (const auto &entry : reader.entries()) {
+      if (entry.path_ != "EPUB/empty.txt") {
+        writer.copy(reader, entry);
+      }
+    }
+    writer.add("EPUB/new.txt", "new");
+    writer.close();
+  }
+
+  kepub::ZipReader copy("zip_reader_copy.zip");
+  REQUIRE(std::size(copy.entries()) == 3);
+  CHECK(copy.entries()[0].path_ == "mimetype");
+  CHECK(copy.entries()[1].compressed_size_ ==
+        reader.entries()[1].compressed_size_);
+  CHECK(copy.entries()[1].crc32_ == reader.entries()[1].crc32_);
+  CHECK(copy.read("mimetype") == "application/epub+zip");
+  CHECK(copy.read("EPUB/text.txt") == text);
+  CHECK(copy.read("EPUB/new.txt") == "new");
+}
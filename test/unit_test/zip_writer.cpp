@@ -0,0 +1,82 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <klib/util.h>
+#include <zlib.h>
+#include <catch2/catch.hpp>
+
+#include "zip_writer.h"
+
+namespace {
+
+std::uint32_t get32(std::string_view data, std::size_t offset) {
+  std::uint32_t result = 0;
+  for (std::size_t i = 0; i < 4; ++i) {
+    result |= static_cast<std::uint32_t>(
+                  static_cast<std::uint8_t>(data[offset + i]))
+              << (8 * i);
+  }
+  return result;
+}
+
+std::uint16_t get16(std::string_view data, std::size_t offset) {
+  return static_cast<std::uint16_t>(get32(data, offset) & 0xFFFF);
+}
+
+std::string inflate(std::string_view data, std::size_t size) {
+  z_stream stream = {};
+  REQUIRE(inflateInit2(&stream, -MAX_WBITS) == Z_OK);
+
+  std::string result(size, '\0');
+  stream.next_in =
+      reinterpret_cast<Bytef *>(const_cast<char *>(std::data(data)));
+  stream.avail_in = static_cast<uInt>(std::size(data));
+  stream.next_out = reinterpret_cast<Bytef *>(std::data(result));
+  stream.avail_out = static_cast<uInt>(size);
+  CHECK(::inflate(&stream, Z_FINISH) == Z_STREAM_END);
+  inflateEnd(&stream);
+
+  return result;
+}
+
+}  // namespace
+
+TEST_CASE("ZipWriter", "[zip_writer]") {
+  const std::string text(1000, 'a');
+
+  kepub::ZipWriter writer("zip_writer.zip");
+  writer.add("mimetype", "application/epub+zip", false);
+  writer.add("EPUB/text.txt", text);
+  writer.close();
+
+  const auto zip = klib::read_file("zip_writer.zip", true);
+
+  // The mimetype is stored right after the first local header
+  REQUIRE(std::size(zip) > 38);
+  CHECK(get32(zip, 0) == 0x04034B50);
+  CHECK(get16(zip, 8) == 0);
+  CHECK(get32(zip, 18) == 20);
+  CHECK(zip.substr(30, 8) == "mimetype");
+  CHECK(zip.substr(38, 20) == "application/epub+zip");
+
+  // The text is deflated
+  const std::size_t offset = 58;
+  CHECK(get32(zip, offset) == 0x04034B50);
+  CHECK(get16(zip, offset + 8) == 8);
+  const auto compressed_size = get32(zip, offset + 18);
+  CHECK(compressed_size < std::size(text));
+  CHECK(get32(zip, offset + 22) == std::size(text));
+  CHECK(get32(zip, offset + 14) ==
+        crc32(0, reinterpret_cast<const Bytef *>(std::data(text)),
+              static_cast<uInt>(std::size(text))));
+  CHECK(inflate(std::string_view(zip).substr(offset + 30 + 13, compressed_size),
+                std::size(text)) == text);
+
+  // End of central directory
+  const auto end = std::size(zip) - 22;
+  CHECK(get32(zip, end) == 0x06054B50);
+  CHECK(get16(zip, end + 10) == 2);
+  CHECK(get32(zip, get32(zip, end + 16)) == 0x02014B50);
+}
@@ -3,6 +3,7 @@
 #include <filesystem>
 #include <string>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #include <klib/archive.h>
@@ -11,6 +12,8 @@
 #include <CLI/CLI.hpp>
 
 #include "epub.h"
+#include "trans.h"
+#include "txt_parser.h"
 #include "util.h"
 #include "version.h"
 
@@ -31,6 +34,12 @@ int main(int argc, const char *argv[]) try {
   app.add_flag("-t,--translation", translation,
                "Translate Traditional Chinese to Simplified Chinese");
 
+  std::string replace_dict;
+  app.add_option("--replace-dict", replace_dict,
+                 "Specify a dictionary of extra replacements, each line is "
+                 "the string to be replaced and its replacement separated "
+                 "by a tab");
+
   bool connect = false;
   app.add_flag("-c,--connect", connect, "Remove extra line breaks");
 
@@ -48,64 +57,66 @@ int main(int argc, const char *argv[]) try {
 
   CLI11_PARSE(app, argc, argv)
 
+  if (!std::empty(replace_dict)) {
+    kepub::load_replace_dict(replace_dict);
+  }
+
   kepub::check_is_txt_file(file_name);
 
   auto book_name = kepub::stem(file_name);
   auto epub_name = book_name + ".epub";
   auto backup_epub_name = book_name + "-back-up.epub";
-  auto zip_name = book_name + ".zip";
   kepub::check_file_exist(epub_name);
 
-  if (std::filesystem::exists(book_name)) {
-    kepub::remove_file_or_dir(book_name);
-  }
+  // The testing book is unpacked, so that it can be compared with the standard
+  // directory. Otherwise the entries are copied from the backup
   if (testing) {
     book_name.append("-test");
+    if (std::filesystem::exists(book_name)) {
+      kepub::remove_file_or_dir(book_name);
+    }
     klib::decompress(epub_name, book_name);
   } else {
-    klib::decompress(epub_name, book_name);
     std::filesystem::rename(epub_name, backup_epub_name);
   }
 
   kepub::Novel novel;
   novel.book_info_.name_ = book_name;
 
-  auto vec = kepub::read_file_to_vec(file_name, translation);
-  auto size = std::size(vec);
-
-  std::string title_prefix = "[WEB] ";
-  auto title_prefix_size = std::size(title_prefix);
-
-  std::string volume_name;
-  std::string volume_prefix = "[VOLUME] ";
-  auto volume_prefix_size = std::size(volume_prefix);
-
-  for (std::size_t i = 0; i < size; ++i) {
-    if (vec[i].starts_with(volume_prefix)) {
-      volume_name = vec[i].substr(volume_prefix_size);
-      kepub::volume_name_check(volume_name);
-      novel.volumes_.emplace_back(volume_name);
-    } else if (vec[i].starts_with(title_prefix)) {
-      auto title = vec[i].substr(title_prefix_size);
-      kepub::title_check(title);
-      ++i;
-
-      std::vector<std::string> content;
-      for (; i < size && !(vec[i].starts_with(title_prefix) ||
-                           vec[i].starts_with(volume_prefix));
-           ++i) {
-        auto line = vec[i];
-        kepub::str_check(line);
-        kepub::push_back(content, line, connect);
-      }
-      --i;
+  // The unknown characters are reported once, in a summary
+  kepub::Diagnostics diagnostics;
 
-      if (std::empty(novel.volumes_)) {
-        novel.volumes_.emplace_back();
+  kepub::TxtHandler handler;
+  handler.volume_ = [&](std::string volume_name) {
+    novel.volumes_.emplace_back(volume_name);
+  };
+  handler.chapter_ = [&](std::string title, std::vector<std::string> texts) {
+    if (std::empty(novel.volumes_)) {
+      novel.volumes_.emplace_back();
+    }
+    auto &chapters = novel.volumes_.back().chapters_;
+
+    kepub::WarningBuffer warnings(kepub::location(
+        std::size(novel.volumes_) - 1, std::size(chapters), title));
+    kepub::ParagraphAssembler assembler(connect);
+    {
+      kepub::WarningBuffer::Scope scope(warnings);
+      for (const auto &line : texts) {
+        kepub::str_check(line);
+        assembler.add(line);
       }
-      novel.volumes_.back().chapters_.emplace_back(title, content);
     }
-  }
+    warnings.flush(&diagnostics);
+
+    chapters.emplace_back(title, assembler.take());
+  };
+
+  kepub::TxtParser parser(std::move(handler), translation);
+  parser.parse_file(file_name);
+  kepub::report_title_issues(kepub::check_titles(novel), &diagnostics);
+  diagnostics.report();
+
+  kepub::log_trans_stats();
 
   kepub::Epub epub;
   // For testing
@@ -114,10 +125,10 @@ int main(int argc, const char *argv[]) try {
   }
 
   epub.set_novel(novel);
-  epub.append();
-
-  if (!testing) {
-    kepub::remove_file_or_dir(book_name);
+  if (testing) {
+    epub.append();
+  } else {
+    epub.append(backup_epub_name);
   }
 
   if (remove) {
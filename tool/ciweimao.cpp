@@ -273,23 +273,28 @@ int main(int argc, const char *argv[]) try {
   klib::info("Start downloading novel content");
   kepub::ProgressBar bar(chapter_count, book_info.name_);
 
-  for (auto &volume : volumes) {
+  book_info.source_ = "刺猬猫";
+
+  kepub::OrderedTxtWriter writer(book_info, volumes);
+
+  for (std::size_t i = 0; i < std::size(volumes); ++i) {
+    auto &chapters = volumes[i].chapters_;
     limited.execute([&] {
       task_group.run([&] {
-        oneapi::tbb::parallel_for_each(
-            volume.chapters_, [&](kepub::Chapter &chapter) {
+        oneapi::tbb::parallel_for(
+            std::size_t(0), std::size(chapters), [&](std::size_t j) {
+              auto &chapter = chapters[j];
               bar.set_postfix_text(chapter.title_);
               bar.tick();
               chapter.texts_ = get_content(token, chapter.chapter_id_);
+              writer.done(i, j);
             });
       });
     });
     limited.execute([&] { task_group.wait(); });
   }
 
-  book_info.source_ = "刺猬猫";
-
-  kepub::generate_txt(book_info, volumes);
+  writer.close();
   klib::info("Novel '{}' download completed", book_info.name_);
 } catch (const klib::Exception &err) {
   klib::error(err.what());
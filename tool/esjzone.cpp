@@ -3,6 +3,7 @@
 #include <exception>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include <klib/exception.h>
@@ -73,9 +74,13 @@ std::pair<kepub::BookInfo, std::vector<kepub::Volume>> get_info(
           .node();
   CHECK_NODE(node);
 
+  std::vector<std::string> introduction;
   for (const auto &child : node.children()) {
-    kepub::push_back(book_info.introduction_,
-                     kepub::trans_str(child.text().as_string(), translation));
+    introduction.emplace_back(child.text().as_string());
+  }
+  kepub::trans_lines(introduction, translation);
+  for (const auto &line : introduction) {
+    kepub::push_back(book_info.introduction_, line);
   }
 
   node = doc.select_node(
@@ -86,11 +91,18 @@ std::pair<kepub::BookInfo, std::vector<kepub::Volume>> get_info(
              .node();
   CHECK_NODE(node);
 
-  std::vector<kepub::Volume> volumes;
+  std::vector<std::string> urls;
+  std::vector<std::string> titles;
   for (const auto &child : node.children("a")) {
-    const std::string may_be_url = child.attribute("href").as_string();
-    const auto title =
-        kepub::trans_str(child.child("p").text().as_string(), translation);
+    urls.emplace_back(child.attribute("href").as_string());
+    titles.emplace_back(child.child("p").text().as_string());
+  }
+  kepub::trans_lines(titles, translation);
+
+  std::vector<kepub::Volume> volumes;
+  for (std::size_t i = 0; i < std::size(urls); ++i) {
+    const auto &may_be_url = urls[i];
+    auto &title = titles[i];
 
     if (!(may_be_url.starts_with("https://www.esjzone.cc/") ||
           may_be_url.starts_with("https://www.esjzone.net/"))) {
@@ -100,7 +112,7 @@ std::pair<kepub::BookInfo, std::vector<kepub::Volume>> get_info(
         volumes.emplace_back();
       }
 
-      volumes.back().chapters_.emplace_back(may_be_url, title);
+      volumes.back().chapters_.emplace_back(may_be_url, std::move(title));
     }
   }
 
@@ -147,6 +159,15 @@ std::vector<std::string> get_content(const std::string &url, bool translation,
   CHECK_NODE(node);
 
   std::vector<std::string> result;
+  // Text lines between images are translated together
+  std::vector<std::string> lines;
+  auto flush = [&] {
+    kepub::trans_lines(lines, translation);
+    for (const auto &line : lines) {
+      kepub::push_back(result, line);
+    }
+    lines.clear();
+  };
 
   const static std::string image_prefix = "[IMAGE] ";
   const static auto image_prefix_size = std::size(image_prefix);
@@ -154,6 +175,8 @@ std::vector<std::string> get_content(const std::string &url, bool translation,
   for (const auto &text : kepub::get_node_texts(node)) {
     for (const auto &line : klib::split_str(text, "\n")) {
       if (line.starts_with(image_prefix)) {
+        flush();
+
         try {
           const auto image_url = line.substr(image_prefix_size);
           const auto image = http_get(image_url, proxy);
@@ -174,11 +197,13 @@ std::vector<std::string> get_content(const std::string &url, bool translation,
           klib::warn("{}: {}", err.what(), line);
         }
       } else {
-        kepub::push_back(result, kepub::trans_str(line, translation));
+        lines.push_back(line);
       }
     }
   }
 
+  flush();
+
   return result;
 }
 
@@ -197,6 +222,12 @@ int main(int argc, const char *argv[]) try {
   app.add_flag("-t,--translation", translation,
                "Translate Traditional Chinese to Simplified Chinese");
 
+  std::string replace_dict;
+  app.add_option("--replace-dict", replace_dict,
+                 "Specify a dictionary of extra replacements, each line is "
+                 "the string to be replaced and its replacement separated "
+                 "by a tab");
+
   auto hardware_concurrency = std::thread::hardware_concurrency();
   std::int32_t max_concurrency = 0;
   app.add_option("-m,--multithreading", max_concurrency,
@@ -212,6 +243,10 @@ int main(int argc, const char *argv[]) try {
 
   CLI11_PARSE(app, argc, argv)
 
+  if (!std::empty(replace_dict)) {
+    kepub::load_replace_dict(replace_dict);
+  }
+
   kepub::check_is_book_id(book_id);
   if (!std::empty(proxy)) {
     klib::info("Use proxy: {}", proxy);
@@ -237,21 +272,28 @@ int main(int argc, const char *argv[]) try {
   oneapi::tbb::task_arena limited(max_concurrency);
   oneapi::tbb::task_group task_group;
 
-  for (auto &volume : volumes) {
+  kepub::OrderedTxtWriter writer(book_info, volumes);
+
+  for (std::size_t i = 0; i < std::size(volumes); ++i) {
+    auto &chapters = volumes[i].chapters_;
     limited.execute([&] {
       task_group.run([&] {
-        oneapi::tbb::parallel_for_each(
-            volume.chapters_, [&](kepub::Chapter &chapter) {
+        oneapi::tbb::parallel_for(
+            std::size_t(0), std::size(chapters), [&](std::size_t j) {
+              auto &chapter = chapters[j];
               bar.set_postfix_text(chapter.title_);
               bar.tick();
               chapter.texts_ = get_content(chapter.url_, translation, proxy);
+              writer.done(i, j);
             });
       });
     });
     limited.execute([&] { task_group.wait(); });
   }
 
-  kepub::generate_txt(book_info, volumes);
+  kepub::log_trans_stats();
+
+  writer.close();
   klib::info("Novel '{}' download completed", book_info.name_);
 } catch (const klib::Exception &err) {
   klib::error(err.what());
@@ -1,17 +1,21 @@
 #include <cstddef>
 #include <cstdlib>
+#include <deque>
 #include <exception>
 #include <filesystem>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <klib/archive.h>
 #include <klib/exception.h>
 #include <klib/log.h>
+#include <oneapi/tbb.h>
 #include <CLI/CLI.hpp>
 
 #include "epub.h"
 #include "trans.h"
+#include "txt_parser.h"
 #include "util.h"
 #include "version.h"
 
@@ -50,6 +54,12 @@ int main(int argc, const char *argv[]) try {
   app.add_flag("-t,--translation", translation,
                "Translate Traditional Chinese to Simplified Chinese");
 
+  std::string replace_dict;
+  app.add_option("--replace-dict", replace_dict,
+                 "Specify a dictionary of extra replacements, each line is "
+                 "the string to be replaced and its replacement separated "
+                 "by a tab");
+
   bool connect = false;
   app.add_flag("-c,--connect", connect, "Remove extra line breaks");
 
@@ -79,6 +89,10 @@ int main(int argc, const char *argv[]) try {
 
   CLI11_PARSE(app, argc, argv)
 
+  if (!std::empty(replace_dict)) {
+    kepub::load_replace_dict(replace_dict);
+  }
+
   if (std::filesystem::is_directory(file_name)) {
     compress_dir_to_epub(file_name, remove, flush_font);
     std::exit(EXIT_SUCCESS);
@@ -148,97 +162,105 @@ int main(int argc, const char *argv[]) try {
     epub.set_datetime(datetime);
   }
 
-  auto vec = kepub::read_file_to_vec(file_name, translation);
-  auto size = std::size(vec);
+  // One buffer for each item of the file, printed in order after the chapters
+  // are checked in parallel
+  std::deque<kepub::WarningBuffer> warnings;
 
-  std::string title_prefix = "[WEB] ";
-  auto title_prefix_size = std::size(title_prefix);
-
-  std::string volume_prefix = "[VOLUME] ";
-  auto volume_prefix_size = std::size(volume_prefix);
-
-  std::string author_prefix = "[AUTHOR]";
-  std::string introduction_prefix = "[INTRO]";
-  std::string postscript_prefix = "[POST]";
+  struct ChapterItem {
+    std::size_t volume_index_;
+    std::size_t chapter_index_;
+    kepub::WarningBuffer *warnings_;
+    std::int32_t word_count_ = 0;
+  };
+  std::vector<ChapterItem> chapter_items;
 
   std::int32_t word_count = 0;
 
-  auto is_prefix = [&](const std::string &line) {
-    return line.starts_with(author_prefix) ||
-           line.starts_with(introduction_prefix) ||
-           line.starts_with(postscript_prefix) ||
-           line.starts_with(title_prefix) || line.starts_with(volume_prefix);
+  kepub::TxtHandler handler;
+  handler.author_ = [&](std::string author) {
+    novel.book_info_.author_ = std::move(author);
+    klib::info("Author: {}", novel.book_info_.author_);
   };
+  handler.introduction_ = [&](std::string line) {
+    kepub::WarningBuffer::Scope scope(warnings.emplace_back("introduction"));
+    if (!no_check) {
+      kepub::str_check(line);
+    }
 
-  for (std::size_t i = 0; i < size; ++i) {
-    if (vec[i].starts_with(author_prefix)) {
-      ++i;
-
-      novel.book_info_.author_ = vec[i];
-      klib::info("Author: {}", novel.book_info_.author_);
-    } else if (vec[i].starts_with(introduction_prefix)) {
-      ++i;
+    word_count += kepub::str_size(line);
+    kepub::push_back(novel.book_info_.introduction_, line, connect,
+                     !no_check);
+  };
+  handler.postscript_ = [&](std::string line) {
+    kepub::WarningBuffer::Scope scope(warnings.emplace_back("postscript"));
+    if (!no_check) {
+      kepub::str_check(line);
+    }
 
-      for (; i < size && !is_prefix(vec[i]); ++i) {
-        auto line = vec[i];
-        if (!no_check) {
-          kepub::str_check(line);
-        }
+    word_count += kepub::str_size(line);
+    kepub::push_back(novel.postscript_, line, connect, !no_check);
+  };
+  handler.volume_ = [&](std::string volume_name) {
+    novel.volumes_.emplace_back(volume_name);
+  };
+  handler.chapter_ = [&](std::string title, std::vector<std::string> texts) {
+    if (std::empty(novel.volumes_)) {
+      novel.volumes_.emplace_back();
+    }
 
-        word_count += kepub::str_size(line);
-        kepub::push_back(novel.book_info_.introduction_, line, connect,
-                         !no_check);
-      }
-      --i;
-    } else if (vec[i].starts_with(postscript_prefix)) {
-      ++i;
-
-      for (; i < size && !is_prefix(vec[i]); ++i) {
-        auto line = vec[i];
-        if (!no_check) {
-          kepub::str_check(line);
-        }
+    auto &chapters = novel.volumes_.back().chapters_;
+    const auto volume_index = std::size(novel.volumes_) - 1;
+    const auto chapter_index = std::size(chapters);
+    chapter_items.push_back(
+        {volume_index, chapter_index,
+         &warnings.emplace_back(
+             kepub::location(volume_index, chapter_index, title))});
+
+    auto &chapter = chapters.emplace_back();
+    chapter.title_ = std::move(title);
+    chapter.texts_ = std::move(texts);
+  };
 
-        word_count += kepub::str_size(line);
-        kepub::push_back(novel.postscript_, line, connect, !no_check);
-      }
-      --i;
-    } else if (vec[i].starts_with(volume_prefix)) {
-      auto volume_name = vec[i].substr(volume_prefix_size);
-      if (!no_check) {
-        kepub::volume_name_check(volume_name);
-      }
-
-      novel.volumes_.emplace_back(volume_name);
-    } else if (vec[i].starts_with(title_prefix)) {
-      auto title = vec[i].substr(title_prefix_size);
-      if (!no_check) {
-        kepub::title_check(title);
-      }
-
-      ++i;
-
-      std::vector<std::string> content;
-      for (; i < size && !is_prefix(vec[i]); ++i) {
-        auto line = vec[i];
-        if (!no_check) {
-          kepub::str_check(line);
+  kepub::TxtParser parser(std::move(handler), translation);
+  parser.parse_file(file_name);
+
+  oneapi::tbb::enumerable_thread_specific<kepub::ParagraphAssembler> assemblers(
+      connect, !no_check);
+  oneapi::tbb::parallel_for(
+      std::size_t(0), std::size(chapter_items), [&](std::size_t i) {
+        auto &item = chapter_items[i];
+        auto &chapter =
+            novel.volumes_[item.volume_index_].chapters_[item.chapter_index_];
+
+        kepub::WarningBuffer::Scope scope(*item.warnings_);
+        auto &assembler = assemblers.local();
+        for (const auto &line : chapter.texts_) {
+          if (!no_check) {
+            kepub::str_check(line);
+          }
+
+          item.word_count_ += kepub::str_size(line);
+          assembler.add(line);
         }
+        chapter.texts_ = assembler.take();
+      });
 
-        word_count += kepub::str_size(line);
-        kepub::push_back(content, line, connect, !no_check);
-      }
-      --i;
-
-      if (std::empty(novel.volumes_)) {
-        novel.volumes_.emplace_back();
-      }
-      novel.volumes_.back().chapters_.emplace_back(title, content);
-    }
+  kepub::Diagnostics diagnostics;
+  for (auto &item : warnings) {
+    item.flush(&diagnostics);
+  }
+  if (!no_check) {
+    kepub::report_title_issues(kepub::check_titles(novel), &diagnostics);
+  }
+  diagnostics.report();
+  for (const auto &item : chapter_items) {
+    word_count += item.word_count_;
   }
 
   klib::info("Total words: {}", word_count);
 
+  kepub::log_trans_stats();
+
   if (only_check) {
     klib::info("Novel '{}' check operation completed", book_name);
     return EXIT_SUCCESS;
@@ -259,10 +281,6 @@ int main(int argc, const char *argv[]) try {
     }
   }
 
-  if (std::empty(uuid) && std::empty(datetime)) {
-    kepub::remove_file_or_dir(book_name);
-  }
-
   klib::info("The epub of novel '{}' was successfully generated", book_name);
 } catch (const klib::Exception &err) {
   klib::error(err.what());
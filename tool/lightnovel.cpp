@@ -41,6 +41,15 @@ std::vector<std::string> get_content(const pugi::xml_document &doc,
   CHECK_NODE(node);
 
   std::vector<std::string> result;
+  // Text lines between images are translated together
+  std::vector<std::string> lines;
+  auto flush = [&] {
+    kepub::trans_lines(lines, translation);
+    for (const auto &line : lines) {
+      kepub::push_back(result, line);
+    }
+    lines.clear();
+  };
 
   static std::int32_t count = 0;
   const static std::string image_prefix = "[IMAGE] ";
@@ -49,6 +58,8 @@ std::vector<std::string> get_content(const pugi::xml_document &doc,
   for (const auto &text : kepub::get_node_texts(node, true)) {
     for (const auto &line : klib::split_str(text, "\n")) {
       if (line.starts_with(image_prefix)) {
+        flush();
+
         try {
           const auto image_url = line.substr(image_prefix_size);
           const auto image = http_get_rss(image_url, proxy);
@@ -73,11 +84,13 @@ std::vector<std::string> get_content(const pugi::xml_document &doc,
           klib::warn("{}: {}", err.what(), line);
         }
       } else {
-        kepub::push_back(result, kepub::trans_str(line, translation));
+        lines.push_back(line);
       }
     }
   }
 
+  flush();
+
   return result;
 }
 
@@ -96,6 +109,12 @@ int main(int argc, const char *argv[]) try {
   app.add_flag("-t,--translation", translation,
                "Translate Traditional Chinese to Simplified Chinese");
 
+  std::string replace_dict;
+  app.add_option("--replace-dict", replace_dict,
+                 "Specify a dictionary of extra replacements, each line is "
+                 "the string to be replaced and its replacement separated "
+                 "by a tab");
+
   std::string proxy;
   app.add_flag("-p{http://127.0.0.1:1080},--proxy{http://127.0.0.1:1080}",
                proxy, "Use proxy")
@@ -103,6 +122,10 @@ int main(int argc, const char *argv[]) try {
 
   CLI11_PARSE(app, argc, argv)
 
+  if (!std::empty(replace_dict)) {
+    kepub::load_replace_dict(replace_dict);
+  }
+
   kepub::check_is_book_id(book_id);
   if (!std::empty(proxy)) {
     klib::info("Use proxy: {}", proxy);
@@ -119,6 +142,9 @@ int main(int argc, const char *argv[]) try {
 
   klib::write_file(book_name + ".txt", false,
                    boost::join(content, "\n") + "\n");
+
+  kepub::log_trans_stats();
+
   klib::info("Novel '{}' download completed", book_name);
 } catch (const klib::Exception &err) {
   klib::error(err.what());
@@ -5,6 +5,7 @@
 #include <string>
 #include <thread>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #include <klib/exception.h>
@@ -134,9 +135,10 @@ std::tuple<std::string, kepub::BookInfo, std::vector<kepub::Volume>> get_info(
                 "div[@class='box-footer z-i']/div")
              .node();
   CHECK_NODE(node);
-  for (const auto &child : klib::split_str(node.text().as_string(), "\n")) {
-    kepub::push_back(book_info.introduction_,
-                     kepub::trans_str(child, translation));
+  auto introduction = klib::split_str(node.text().as_string(), "\n");
+  kepub::trans_lines(introduction, translation);
+  for (const auto &line : introduction) {
+    kepub::push_back(book_info.introduction_, line);
   }
 
   node = doc.select_node(
@@ -149,9 +151,7 @@ std::tuple<std::string, kepub::BookInfo, std::vector<kepub::Volume>> get_info(
   std::vector<kepub::Volume> volumes;
   for (const auto &child : node.children("li")) {
     if (child.attribute("class").value() == std::string("chapter-box")) {
-      auto volume_name =
-          kepub::trans_str(child.child("b").text().as_string(), translation);
-      volumes.emplace_back(volume_name);
+      volumes.emplace_back(child.child("b").text().as_string());
     } else {
       if (std::empty(volumes)) {
         volumes.emplace_back();
@@ -165,9 +165,8 @@ std::tuple<std::string, kepub::BookInfo, std::vector<kepub::Volume>> get_info(
           volumes.back().chapters_.emplace_back();
           volumes.back().chapters_.back().url_ = chapter_url;
         } else if (chapter.name() == std::string("li")) {
-          auto chapter_title = kepub::trans_str(
-              chapter.child("span").text().as_string(), translation);
-          volumes.back().chapters_.back().title_ = chapter_title;
+          volumes.back().chapters_.back().title_ =
+              chapter.child("span").text().as_string();
 
           std::string pay_str = kepub::trans_str(
               chapter.child("small").text().as_string(), translation);
@@ -180,6 +179,23 @@ std::tuple<std::string, kepub::BookInfo, std::vector<kepub::Volume>> get_info(
     }
   }
 
+  // Volume names and chapter titles are translated together
+  std::vector<std::string> titles;
+  for (const auto &volume : volumes) {
+    titles.push_back(volume.title_);
+    for (const auto &chapter : volume.chapters_) {
+      titles.push_back(chapter.title_);
+    }
+  }
+  kepub::trans_lines(titles, translation);
+  auto title = std::begin(titles);
+  for (auto &volume : volumes) {
+    volume.title_ = std::move(*title++);
+    for (auto &chapter : volume.chapters_) {
+      chapter.title_ = std::move(*title++);
+    }
+  }
+
   node = doc.select_node(
                 "/html/body/div/div[@id='pjax-container']/div/"
                 "section[@class='content']/div[1]/div/div/div[@class='box-body "
@@ -239,6 +255,15 @@ std::vector<std::string> get_content(const std::string &url, bool translation,
   CHECK_NODE(node);
 
   std::vector<std::string> result;
+  // Text lines between images are translated together
+  std::vector<std::string> lines;
+  auto flush = [&] {
+    kepub::trans_lines(lines, translation);
+    for (const auto &line : lines) {
+      kepub::push_back(result, line);
+    }
+    lines.clear();
+  };
 
   const static std::string image_prefix = "[IMAGE] ";
   const static auto image_prefix_size = std::size(image_prefix);
@@ -246,6 +271,8 @@ std::vector<std::string> get_content(const std::string &url, bool translation,
   for (const auto &text : kepub::get_node_texts(node)) {
     for (const auto &line : klib::split_str(text, "\n")) {
       if (line.starts_with(image_prefix)) {
+        flush();
+
         try {
           const auto image_url = line.substr(image_prefix_size);
           const auto image = http_get(image_url, proxy);
@@ -266,11 +293,13 @@ std::vector<std::string> get_content(const std::string &url, bool translation,
           klib::warn("{}: {}", err.what(), line);
         }
       } else {
-        kepub::push_back(result, kepub::trans_str(line, translation));
+        lines.push_back(line);
       }
     }
   }
 
+  flush();
+
   return result;
 }
 
@@ -289,6 +318,12 @@ int main(int argc, const char *argv[]) try {
   app.add_flag("-t,--translation", translation,
                "Translate Traditional Chinese to Simplified Chinese");
 
+  std::string replace_dict;
+  app.add_option("--replace-dict", replace_dict,
+                 "Specify a dictionary of extra replacements, each line is "
+                 "the string to be replaced and its replacement separated "
+                 "by a tab");
+
   auto hardware_concurrency = std::thread::hardware_concurrency();
   std::int32_t max_concurrency = 0;
   app.add_option("-m,--multithreading", max_concurrency,
@@ -304,6 +339,10 @@ int main(int argc, const char *argv[]) try {
 
   CLI11_PARSE(app, argc, argv)
 
+  if (!std::empty(replace_dict)) {
+    kepub::load_replace_dict(replace_dict);
+  }
+
   kepub::check_is_book_id(book_id);
 
   klib::info("Maximum concurrency: {}", max_concurrency);
@@ -334,11 +373,15 @@ int main(int argc, const char *argv[]) try {
   oneapi::tbb::task_arena limited(max_concurrency);
   oneapi::tbb::task_group task_group;
 
-  for (auto &volume : volumes) {
+  kepub::OrderedTxtWriter writer(book_info, volumes);
+
+  for (std::size_t i = 0; i < std::size(volumes); ++i) {
+    auto &chapters = volumes[i].chapters_;
     limited.execute([&] {
       task_group.run([&] {
-        oneapi::tbb::parallel_for_each(
-            volume.chapters_, [&](kepub::Chapter &chapter) {
+        oneapi::tbb::parallel_for(
+            std::size_t(0), std::size(chapters), [&](std::size_t j) {
+              auto &chapter = chapters[j];
               bar.set_postfix_text(chapter.title_);
               bar.tick();
 
@@ -346,13 +389,16 @@ int main(int argc, const char *argv[]) try {
                 pay(chapter.url_, chapter.pay_, token, proxy);
               }
               chapter.texts_ = get_content(chapter.url_, translation, proxy);
+              writer.done(i, j);
             });
       });
     });
     limited.execute([&] { task_group.wait(); });
   }
 
-  kepub::generate_txt(book_info, volumes);
+  kepub::log_trans_stats();
+
+  writer.close();
   klib::info("Novel '{}' download completed", book_info.name_);
 } catch (const klib::Exception &err) {
   klib::error(err.what());
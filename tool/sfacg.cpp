@@ -198,23 +198,28 @@ int main(int argc, const char *argv[]) try {
   oneapi::tbb::task_arena limited(max_concurrency);
   oneapi::tbb::task_group task_group;
 
-  for (auto &volume : volumes) {
+  book_info.source_ = "菠萝包";
+
+  kepub::OrderedTxtWriter writer(book_info, volumes);
+
+  for (std::size_t i = 0; i < std::size(volumes); ++i) {
+    auto &chapters = volumes[i].chapters_;
     limited.execute([&] {
       task_group.run([&] {
-        oneapi::tbb::parallel_for_each(
-            volume.chapters_, [&](kepub::Chapter &chapter) {
+        oneapi::tbb::parallel_for(
+            std::size_t(0), std::size(chapters), [&](std::size_t j) {
+              auto &chapter = chapters[j];
               bar.set_postfix_text(chapter.title_);
               bar.tick();
               chapter.texts_ = get_content(chapter.chapter_id_);
+              writer.done(i, j);
             });
       });
     });
     limited.execute([&] { task_group.wait(); });
   }
 
-  book_info.source_ = "菠萝包";
-
-  kepub::generate_txt(book_info, volumes);
+  writer.close();
   klib::info("Novel '{}' download completed", book_info.name_);
 } catch (const klib::Exception &err) {
   klib::error(err.what());